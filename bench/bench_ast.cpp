@@ -0,0 +1,200 @@
+#include "helper_bench.hpp"
+#include "ast_data.hpp"
+#include "ast_visitor.hpp"
+#include "flat_ast.hpp"
+#include "parser.hpp"
+
+#include <string>
+#include <tuple>
+
+namespace {
+
+using klang::ast::Base;
+
+std::size_t count_dynamic(Base const* node);
+
+template <typename T>
+bool count_binary(Base const* node, std::size_t& count) {
+  if (auto data = dynamic_cast<T const*>(node)) {
+    count += count_dynamic(data->lhs().get()) +
+        count_dynamic(data->rhs().get());
+    return true;
+  }
+  return false;
+}
+
+template <typename T>
+bool count_unary(Base const* node, std::size_t& count) {
+  if (auto data = dynamic_cast<T const*>(node)) {
+    count += count_dynamic(data->expression().get());
+    return true;
+  }
+  return false;
+}
+
+template <typename Range>
+std::size_t count_all(Range const& nodes) {
+  std::size_t count = 0;
+  for (auto const& node : nodes) count += count_dynamic(node.get());
+  return count;
+}
+
+// Visitor を使わずに、flat_ast.cpp と同じく dynamic_cast を順に試して
+// 数える。数の多い名前と字句を先に調べて、外れる回数を減らしておく。
+std::size_t count_dynamic(Base const* node) {
+  using namespace klang::ast;
+  if (node == nullptr) return 0;
+  std::size_t count = 1;
+  if (dynamic_cast<IdentifierData const*>(node) ||
+      dynamic_cast<TypeData const*>(node) ||
+      dynamic_cast<IntegerLiteralData const*>(node) ||
+      dynamic_cast<CharacterLiteralData const*>(node) ||
+      dynamic_cast<StringLiteralData const*>(node)) {
+    return count;
+  } else if (auto unit = dynamic_cast<TranslationUnitData const*>(node)) {
+    count += count_all(unit->functions());
+  } else if (auto function =
+             dynamic_cast<FunctionDefinitionData const*>(node)) {
+    count += count_dynamic(function->name().get()) +
+        count_dynamic(function->arguments().get()) +
+        count_dynamic(function->return_type().get()) +
+        count_dynamic(function->body().get());
+  } else if (auto arguments = dynamic_cast<ArgumentListData const*>(node)) {
+    count += count_all(arguments->arguments());
+  } else if (auto argument = dynamic_cast<ArgumentData const*>(node)) {
+    count += count_dynamic(argument->type().get()) +
+        count_dynamic(argument->name().get());
+  } else if (auto compound =
+             dynamic_cast<CompoundStatementData const*>(node)) {
+    count += count_all(compound->statements());
+  } else if (auto if_ = dynamic_cast<IfStatementData const*>(node)) {
+    count += count_dynamic(if_->condition().get()) +
+        count_dynamic(if_->body().get()) +
+        count_dynamic(if_->else_block().get());
+  } else if (auto else_ = dynamic_cast<ElseStatementData const*>(node)) {
+    count += count_dynamic(else_->body().get());
+  } else if (auto while_ = dynamic_cast<WhileStatementData const*>(node)) {
+    count += count_dynamic(while_->condition().get()) +
+        count_dynamic(while_->body().get());
+  } else if (auto for_ = dynamic_cast<ForStatementData const*>(node)) {
+    count += count_dynamic(for_->initialize().get()) +
+        count_dynamic(for_->condition().get()) +
+        count_dynamic(for_->reinitialize().get()) +
+        count_dynamic(for_->body().get());
+  } else if (auto return_ = dynamic_cast<ReturnStatementData const*>(node)) {
+    count += count_dynamic(return_->return_value().get());
+  } else if (auto definition_statement =
+             dynamic_cast<VariableDefinitionStatementData const*>(node)) {
+    count += count_dynamic(definition_statement->variable_definition().get());
+  } else if (auto definition =
+             dynamic_cast<VariableDefinitionData const*>(node)) {
+    count += count_dynamic(definition->type_name().get()) +
+        count_dynamic(definition->variable_name().get()) +
+        count_dynamic(definition->expression().get());
+  } else if (auto expression_statement =
+             dynamic_cast<ExpressionStatementData const*>(node)) {
+    count += count_dynamic(expression_statement->body().get());
+  } else if (auto call =
+             dynamic_cast<FunctionCallExpressionData const*>(node)) {
+    count += count_dynamic(call->function_name().get()) +
+        count_dynamic(call->parameter_list().get());
+  } else if (auto parameters = dynamic_cast<ParameterListData const*>(node)) {
+    count += count_all(parameters->parameters());
+  } else {
+    count_unary<IdentifierExpressionData>(node, count) ||
+    count_unary<IntegerLiteralExpressionData>(node, count) ||
+    count_unary<CharacterLiteralExpressionData>(node, count) ||
+    count_unary<StringLiteralExpressionData>(node, count) ||
+    count_unary<ParenthesizedExpressionData>(node, count) ||
+    count_unary<ParameterData>(node, count) ||
+    count_unary<NotExpressionData>(node, count) ||
+    count_unary<MinusExpressionData>(node, count) ||
+    count_binary<AddExpressionData>(node, count) ||
+    count_binary<SubtractExpressionData>(node, count) ||
+    count_binary<MultiplyExpressionData>(node, count) ||
+    count_binary<DivideExpressionData>(node, count) ||
+    count_binary<ModuloExpressionData>(node, count) ||
+    count_binary<EqualExpressionData>(node, count) ||
+    count_binary<NotEqualExpressionData>(node, count) ||
+    count_binary<LessExpressionData>(node, count) ||
+    count_binary<GreaterExpressionData>(node, count) ||
+    count_binary<LessOrEqualExpressionData>(node, count) ||
+    count_binary<GreaterOrEqualExpressionData>(node, count) ||
+    count_binary<AndExpressionData>(node, count) ||
+    count_binary<OrExpressionData>(node, count) ||
+    count_binary<AssignExpressionData>(node, count) ||
+    count_binary<AddAssignExpressionData>(node, count) ||
+    count_binary<SubtractAssignExpressionData>(node, count) ||
+    count_binary<MultiplyAssignExpressionData>(node, count) ||
+    count_binary<DivideAssignExpressionData>(node, count) ||
+    count_binary<ModuloAssignExpressionData>(node, count);
+  }
+  return count;
+}
+
+class Counter : public klang::ast::Visitor<Counter> {
+ public:
+  void visit(Base const& node) {
+    ++count;
+    Visitor<Counter>::visit(node);
+  }
+  std::size_t count = 0;
+};
+
+std::size_t count_identifiers(klang::flat::Tree const& tree) {
+  std::size_t count = 0;
+  for (klang::flat::Tree::Index i = 0; i < tree.size(); ++i) {
+    count += tree.kind(i) == klang::flat::NodeKind::IDENTIFIER;
+  }
+  return count;
+}
+
+void run(const std::string& name, const std::string& code) {
+  bool success;
+  klang::TokenVector tokens;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  klang::Parser parser(tokens);
+  const auto unit = parser.parse_translation_unit();
+  auto const& data =
+      dynamic_cast<klang::ast::TranslationUnitData const&>(*unit);
+
+  std::size_t dynamic_nodes = 0;
+  bench::report(name + " dynamic_cast count", bench::measure(5, [&] {
+    dynamic_nodes = count_dynamic(unit.get());
+  }));
+  std::size_t visitor_nodes = 0;
+  bench::report(name + " visitor count", bench::measure(5, [&] {
+    Counter counter;
+    counter.visit(*unit);
+    visitor_nodes = counter.count;
+  }));
+  if (dynamic_nodes != visitor_nodes) {
+    std::printf("node counts differ: %zu != %zu\n",
+                dynamic_nodes, visitor_nodes);
+  }
+
+  klang::flat::Tree tree;
+  bench::report(name + " flatten", bench::measure(5, [&] {
+    tree = klang::flat::flatten(*unit);
+  }));
+  std::size_t identifiers = 0;
+  bench::report(name + " flat scan", bench::measure(5, [&] {
+    identifiers += count_identifiers(tree);
+  }));
+  bench::report_bytes(name + " pointer tree",
+                      data.arena()->size() + data.functions().capacity() *
+                      sizeof(klang::ast::FunctionDefinitionPtr));
+  bench::report_bytes(name + " flat tree", tree.memory_usage());
+  if (identifiers == 0) {
+    std::printf("no identifiers\n");
+  }
+}
+
+}  // unnamed namespace
+
+int main() {
+  for (int count : {500, 5000}) {
+    run("functions=" + std::to_string(count), bench::many_functions(count));
+  }
+  return 0;
+}
@@ -0,0 +1,130 @@
+#include "helper_bench.hpp"
+#include "ast_data.hpp"
+#include "parser.hpp"
+
+#include <cstdint>
+#include <string>
+
+namespace {
+
+// 読めたときの経路だけを比べる。規則の呼び出しを模して、何段か関数を
+// 通してノードを返す。インライン展開されると返し方の違いが消えるので、
+// 各段を noinline にする。
+klang::ast::IdentifierData node(0, 0);
+volatile bool fails = false;
+
+using Pointer = klang::ast::IdentifierPtr;
+using Result = klang::ParseResult<klang::ast::Identifier>;
+
+__attribute__((noinline)) Pointer leaf_pointer() {
+  return fails ? nullptr : Pointer(&node);
+}
+
+__attribute__((noinline)) Pointer inner_pointer() {
+  auto ret = leaf_pointer();
+  if (!ret) return nullptr;
+  return ret;
+}
+
+__attribute__((noinline)) Pointer outer_pointer() {
+  auto ret = inner_pointer();
+  if (!ret) return nullptr;
+  return ret;
+}
+
+__attribute__((noinline)) Result leaf_result() {
+  if (fails) return klang::make_left(klang::ParseError{0, 0});
+  return klang::make_right(Pointer(&node));
+}
+
+__attribute__((noinline)) Result inner_result() {
+  auto ret = leaf_result();
+  if (!ret) return ret;
+  return ret;
+}
+
+__attribute__((noinline)) Result outer_result() {
+  return inner_result().and_then([](Pointer p) -> Result {
+    return klang::make_right(std::move(p));
+  });
+}
+
+// 手書きのタグ付き共用体と、同じものを Either で書いたもの。どちらも
+// 自明にコピーできるので、同じ命令列になる。
+struct Tagged {
+  bool is_right;
+  union {
+    klang::ParseError left;
+    klang::ast::Identifier* right;
+  };
+};
+
+using Raw = klang::Either<klang::ParseError, klang::ast::Identifier*>;
+
+__attribute__((noinline)) Tagged leaf_tagged() {
+  Tagged ret;
+  ret.is_right = !fails;
+  if (fails) {
+    ret.left = klang::ParseError{0, 0};
+  } else {
+    ret.right = &node;
+  }
+  return ret;
+}
+
+__attribute__((noinline)) Tagged inner_tagged() {
+  const Tagged ret = leaf_tagged();
+  if (!ret.is_right) return ret;
+  return ret;
+}
+
+__attribute__((noinline)) Tagged outer_tagged() {
+  const Tagged ret = inner_tagged();
+  if (!ret.is_right) return ret;
+  return ret;
+}
+
+__attribute__((noinline)) Raw leaf_raw() {
+  if (fails) return klang::make_left(klang::ParseError{0, 0});
+  return Raw(klang::right_tag, &node);
+}
+
+__attribute__((noinline)) Raw inner_raw() {
+  const Raw ret = leaf_raw();
+  if (!ret) return ret;
+  return ret;
+}
+
+__attribute__((noinline)) Raw outer_raw() {
+  const Raw ret = inner_raw();
+  if (!ret) return ret;
+  return ret;
+}
+
+template <typename F>
+void run(const std::string& name, F f) {
+  const int count = 10000000;
+  std::uintptr_t sum = 0;
+  const double ms = bench::measure(5, [&] {
+    for (int i = 0; i < count; ++i) sum += f();
+  });
+  bench::report(name, ms);
+  if (sum == 1) std::printf("\n");
+}
+
+}  // unnamed namespace
+
+int main() {
+  run("nullptr calls=10000000", [] {
+    return reinterpret_cast<std::uintptr_t>(outer_pointer().release());
+  });
+  run("Either calls=10000000", [] {
+    return reinterpret_cast<std::uintptr_t>((*outer_result()).release());
+  });
+  run("tagged union calls=10000000", [] {
+    return reinterpret_cast<std::uintptr_t>(outer_tagged().right);
+  });
+  run("Either of pointer calls=10000000", [] {
+    return reinterpret_cast<std::uintptr_t>(*outer_raw());
+  });
+}
@@ -0,0 +1,93 @@
+#include "helper_bench.hpp"
+#include "lexer.hpp"
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+
+namespace {
+
+// 約 5 万行のソースの中ほどで 1 文字挿入したときの再字句解析。
+void run_edit() {
+  const std::string code = bench::many_functions(7000);
+  std::string edited = code;
+  const std::size_t offset = edited.find("x :+=", code.size() / 2);
+  edited.insert(offset, "y");
+  const auto old_source = klang::SourceBuffer::borrow(klang::StringRef(code));
+  const auto new_source =
+      klang::SourceBuffer::borrow(klang::StringRef(edited));
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(old_source);
+  const std::string lines =
+      " (" + std::to_string(std::count(code.begin(), code.end(), '\n')) +
+      " lines)";
+  bench::report("edit tokenize" + lines, bench::measure(5, [&] {
+    klang::tokenize(new_source);
+  }));
+  bench::report("edit retokenize" + lines, bench::measure(5, [&] {
+    klang::retokenize(tokens, new_source, klang::Edit{offset, 0, 1});
+  }));
+}
+
+// 大半がコメントと文字列リテラル、字下げからなるソース。
+std::string commented_functions(int count) {
+  const std::string prose =
+      "the quick brown fox jumps over the lazy dog, again and again ";
+  std::string code;
+  for (int i = 0; i < count; ++i) {
+    code += "{~ " + prose + prose + "\n   " + prose + prose +
+        "\n   {~ nested " + prose + "~} " + prose + "~}\n"
+        "def g" + std::to_string(i) + "() -> (int) {\n"
+        "        ~~ " + prose + prose + "\n"
+        "        print(\"" + prose + prose + "\\n\");\n"
+        "                return 0;\n"
+        "}\n";
+  }
+  return code;
+}
+
+void run_comments() {
+  const std::string code = commented_functions(20000);
+  const auto source = klang::SourceBuffer::borrow(klang::StringRef(code));
+  bench::report("tokenize comments and strings (" +
+                std::to_string(code.size() / (1024 * 1024)) + " MiB)",
+                bench::measure(3, [&] {
+    klang::tokenize(source);
+  }));
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(source);
+  bench::report_bytes("literal table", tokens.literals().size());
+}
+
+}  // unnamed namespace
+
+int main() {
+  const std::string code = bench::many_functions(100000);
+  const auto source = klang::SourceBuffer::borrow(klang::StringRef(code));
+  const std::string size =
+      " (" + std::to_string(code.size() / (1024 * 1024)) + " MiB)";
+  bench::report("tokenize" + size, bench::measure(3, [&] {
+    klang::tokenize(source);
+  }));
+  for (unsigned jobs : {1u, 2u, 4u, 8u}) {
+    bench::report("tokenize_in_parallel jobs=" + std::to_string(jobs) + size,
+                  bench::measure(3, [&] {
+      klang::tokenize_in_parallel(source, jobs);
+    }));
+  }
+  bench::report("TokenStream" + size, bench::measure(3, [&] {
+    klang::TokenStream stream(source);
+    while (stream.peek()) stream.advance();
+  }));
+  // トークンが占めるメモリ。
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(source);
+  bench::report_bytes("tokenize tokens", tokens.size() * sizeof(klang::Token));
+  klang::TokenStream stream(source);
+  while (stream.peek()) stream.advance();
+  bench::report_bytes("TokenStream peak window",
+                      stream.peak_window_size() * sizeof(klang::Token));
+  run_comments();
+  run_edit();
+  return 0;
+}
@@ -0,0 +1,213 @@
+#include "helper_bench.hpp"
+#include "parser.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace {
+
+std::string repeat(const std::string& str, int n) {
+  std::string ret;
+  for (int i = 0; i < n; ++i) ret += str;
+  return ret;
+}
+
+std::string function(const std::string& body) {
+  return "def main() -> (int) {\n" + body + "\n  return 0;\n}\n";
+}
+
+// 深く入れ子になった入力。broken なら最後の閉じ括弧を落として構文エラーにする。
+std::string nested_parentheses(int depth, bool broken) {
+  return function("  x := " + repeat("(", depth) + "x" +
+                  repeat(")", depth - broken) + ";");
+}
+
+std::string nested_calls(int depth, bool broken) {
+  return function("  x := " + repeat("f((", depth) + "x" +
+                  repeat("))", depth) .substr(broken) + ";");
+}
+
+std::string nested_unary(int depth, bool broken) {
+  return function("  x := " + repeat("not ~", depth) +
+                  (broken ? "(x" : "x") + ";");
+}
+
+std::string nested_blocks(int depth, bool broken) {
+  return function(repeat("  if (x) { while (x) {\n", depth) + "  x :+= 1;\n" +
+                  repeat("  } }\n", depth).substr(broken));
+}
+
+// 長い二項演算子の列。全ての優先順位を順に使う。
+std::string operator_chain(int length) {
+  return function("  x := a" + repeat(" + b * c - d / e % f", length / 5) +
+                  " < g and h or i;");
+}
+
+void run(const std::string& name, const std::string& code) {
+  bool success;
+  klang::TokenVector tokens;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  for (bool memoize : {false, true}) {
+    const double ms = bench::measure(5, [&] {
+      klang::Parser parser(tokens, memoize);
+      parser.parse_translation_unit();
+    });
+    bench::report(name + (memoize ? " (memoized)" : ""), ms);
+  }
+}
+
+// 構文木を作る時間と、捨てる時間を別々に測る。
+void run_translation_unit(const std::string& name, const std::string& code) {
+  bool success;
+  klang::TokenVector tokens;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  double parse = 1e100;
+  double teardown = 1e100;
+  for (int i = 0; i < 5; ++i) {
+    std::unique_ptr<klang::Parser> parser;
+    klang::ast::TranslationUnitPtr unit;
+    parse = std::min(parse, bench::measure(1, [&] {
+      parser.reset(new klang::Parser(tokens));
+      unit = parser->parse_translation_unit();
+    }));
+    teardown = std::min(teardown, bench::measure(1, [&] {
+      unit.reset();
+      parser.reset();
+    }));
+  }
+  bench::report(name + " parse", parse);
+  bench::report(name + " teardown", teardown);
+}
+
+void run_parallel(const std::string& name, const std::string& code) {
+  bool success;
+  klang::TokenVector tokens;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  for (unsigned jobs : {1u, 2u, 4u, 8u}) {
+    const double ms = bench::measure(5, [&] {
+      klang::Parser parser(tokens);
+      parser.parse_translation_unit_in_parallel(jobs);
+    });
+    bench::report(name + " jobs=" + std::to_string(jobs), ms);
+  }
+}
+
+// 字句解析を含めて、TokenVector を経由する場合と TokenStream の場合を比べる。
+void run_stream(const std::string& name, const std::string& code) {
+  const auto source = klang::SourceBuffer::borrow(klang::StringRef(code));
+  bench::report(name + " tokenize+parse", bench::measure(5, [&] {
+    klang::TokenVector tokens;
+    std::tie(std::ignore, tokens) = klang::tokenize(source);
+    klang::Parser parser(tokens);
+    parser.parse_translation_unit();
+  }));
+  bench::report(name + " stream", bench::measure(5, [&] {
+    klang::Parser parser{klang::TokenStream(source)};
+    parser.parse_translation_unit();
+  }));
+}
+
+// 再帰で読む場合と、明示的なスタックで読む場合を比べる。
+void run_explicit_stack(const std::string& name, const std::string& code) {
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+  bench::report(name + " recursive", bench::measure(5, [&] {
+    klang::Parser parser(tokens);
+    parser.parse_translation_unit();
+  }));
+  bench::report(name + " explicit stack", bench::measure(5, [&] {
+    klang::Parser parser(tokens);
+    parser.use_explicit_stack();
+    parser.parse_translation_unit();
+  }));
+}
+
+// 全ての関数に構文エラーがある入力を、回復しながら一度で読む。
+void run_recovery(const std::string& name, const std::string& code) {
+  std::string broken = code;
+  for (std::size_t i = 0; (i = broken.find("a * 2", i)) != std::string::npos;
+       ) {
+    broken.replace(i, 5, "a * ;");
+  }
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(broken));
+  std::size_t errors = 0;
+  bench::report(name + " errors", bench::measure(5, [&] {
+    klang::Parser parser(tokens);
+    parser.recover_from_errors();
+    parser.parse_translation_unit();
+    errors = parser.diagnostics().size();
+  }));
+  std::printf("%-48s %12zu\n", (name + " diagnostics").c_str(), errors);
+}
+
+// 中ほどの関数の 1 文字を replacement に書き換えたときの、全体の読み直しと
+// 差分の読み直し。長さが変わると、後ろの関数の名前の位置もずらす。
+void run_reparse(const std::string& name, const std::string& code,
+                 const std::string& replacement) {
+  klang::TokenVector old_tokens;
+  std::tie(std::ignore, old_tokens) = klang::tokenize(klang::StringRef(code));
+  std::string edited = code;
+  const std::size_t offset = edited.find("a * 2", code.size() / 2);
+  edited.replace(offset, 1, replacement);
+  const klang::Edit edit{offset, 1, replacement.size()};
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::retokenize(
+      old_tokens, klang::SourceBuffer::borrow(klang::StringRef(edited)),
+      edit);
+  bench::report(name + " full", bench::measure(5, [&] {
+    klang::Parser parser(tokens);
+    parser.parse_translation_unit();
+  }));
+  // 読み直しは古い翻訳単位を消費するので、先に用意しておく。
+  std::vector<klang::ast::TranslationUnitPtr> olds;
+  for (int i = 0; i < 5; ++i) {
+    klang::Parser parser(old_tokens);
+    olds.push_back(parser.parse_translation_unit());
+  }
+  bench::report(name + " incremental", bench::measure(5, [&] {
+    klang::Parser parser(tokens);
+    parser.reparse_translation_unit(std::move(olds.back()), old_tokens, edit);
+    olds.pop_back();
+  }));
+}
+
+}  // unnamed namespace
+
+int main() {
+  for (int depth : {250, 500, 1000}) {
+    for (bool broken : {false, true}) {
+      const std::string suffix =
+          " depth=" + std::to_string(depth) + (broken ? " broken" : "");
+      run("parentheses" + suffix, nested_parentheses(depth, broken));
+      run("calls" + suffix, nested_calls(depth, broken));
+      run("unary" + suffix, nested_unary(depth, broken));
+      run("blocks" + suffix, nested_blocks(depth, broken));
+    }
+  }
+  for (int length : {1000, 10000}) {
+    run("operators length=" + std::to_string(length), operator_chain(length));
+  }
+  for (int count : {500, 5000}) {
+    run_translation_unit("functions=" + std::to_string(count),
+                         bench::many_functions(count));
+  }
+  run_parallel("parallel functions=5000", bench::many_functions(5000));
+  run_stream("functions=5000", bench::many_functions(5000));
+  run_reparse("reparse functions=5000", bench::many_functions(5000), "b");
+  run_reparse("reparse insert functions=5000", bench::many_functions(5000),
+              "abc");
+  for (int count : {500, 5000}) {
+    run_recovery("recovery functions=" + std::to_string(count),
+                 bench::many_functions(count));
+  }
+  run_explicit_stack("functions=5000", bench::many_functions(5000));
+  run_explicit_stack("operators length=10000", operator_chain(10000));
+  run_explicit_stack("parentheses depth=1000", nested_parentheses(1000, false));
+  run_explicit_stack("blocks depth=1000", nested_blocks(1000, false));
+  return 0;
+}
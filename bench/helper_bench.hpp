@@ -0,0 +1,52 @@
+#ifndef KMC_KLANG_BENCH_HELPER_BENCH_HPP
+#define KMC_KLANG_BENCH_HELPER_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+namespace bench {
+
+// f を repeat 回実行し、最も速かった 1 回の時間をミリ秒で返す。
+template <typename F>
+double measure(int repeat, F f) {
+  double best = 1e100;
+  for (int i = 0; i < repeat; ++i) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto stop = std::chrono::steady_clock::now();
+    best = std::min(
+        best, std::chrono::duration<double, std::milli>(stop - start).count());
+  }
+  return best;
+}
+
+inline void report(const std::string& name, double milliseconds) {
+  std::printf("%-48s %12.3f ms\n", name.c_str(), milliseconds);
+}
+
+inline void report_bytes(const std::string& name, std::size_t bytes) {
+  std::printf("%-48s %12zu B\n", name.c_str(), bytes);
+}
+
+// 多数の関数定義からなる、生成されたソース。
+inline std::string many_functions(int count) {
+  std::string code;
+  for (int i = 0; i < count; ++i) {
+    const std::string name = "f" + std::to_string(i);
+    code += "def " + name + "(int a) -> (int) {\n"
+        "  def int var x := a * 2 + 1;\n"
+        "  if (x < 10 and a =/ 3) { x :+= " + name + "(a - 1); }\n"
+        "  else { x := x - 1; }\n"
+        "  while (x > 0) { x :-= 1; }\n"
+        "  return x;\n"
+        "}\n";
+  }
+  return code;
+}
+
+}  // namespace bench
+
+#endif  // KMC_KLANG_BENCH_HELPER_BENCH_HPP
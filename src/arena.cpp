@@ -0,0 +1,64 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+namespace klang {
+namespace ast {
+
+Arena::Arena(std::size_t chunk_size)
+    : chunks_{},
+      chunk_size_{chunk_size},
+      current_{nullptr},
+      end_{nullptr},
+      size_{0}
+{}
+
+void* Arena::allocate(std::size_t size, std::size_t alignment) {
+  const auto align = [alignment](char* p) {
+    const auto address = reinterpret_cast<std::uintptr_t>(p);
+    return p + (-address & (alignment - 1));
+  };
+  char* p = align(current_);
+  if (current_ == nullptr || end_ - p < static_cast<std::ptrdiff_t>(size)) {
+    grow(size + alignment);
+    p = align(current_);
+  }
+  current_ = p + size;
+  size_ += size;
+  return p;
+}
+
+StringRef Arena::copy(StringRef str) {
+  if (str.empty()) {
+    return StringRef("", 0);
+  }
+  char* p = static_cast<char*>(allocate(str.size(), 1));
+  std::memcpy(p, str.data(), str.size());
+  return StringRef(p, str.size());
+}
+
+void Arena::merge(Arena& other) {
+  chunks_.insert(chunks_.end(),
+                 std::make_move_iterator(other.chunks_.begin()),
+                 std::make_move_iterator(other.chunks_.end()));
+  size_ += other.size_;
+  other.chunks_.clear();
+  other.current_ = nullptr;
+  other.end_ = nullptr;
+  other.size_ = 0;
+}
+
+void Arena::grow(std::size_t size) {
+  // 大きすぎる要素は専用のチャンクに置く。
+  const std::size_t chunk_size = std::max(chunk_size_, size);
+  chunks_.emplace_back(new char[chunk_size]);
+  current_ = chunks_.back().get();
+  end_ = current_ + chunk_size;
+}
+
+}  // namespace ast
+}  // namespace klang
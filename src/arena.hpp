@@ -0,0 +1,83 @@
+#ifndef KMC_KLANG_ARENA_HPP
+#define KMC_KLANG_ARENA_HPP
+
+#include "ast.hpp"
+#include "string_ref.hpp"
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace klang {
+namespace ast {
+
+// Arena の上に置かれた要素の列。要素の所有権は Arena が持つ。
+template <typename T>
+class NodeArray {
+ public:
+  using value_type = T;
+  using const_iterator = const T*;
+  using size_type = std::size_t;
+  NodeArray()
+      : data_{nullptr}, size_{0}
+  {}
+  NodeArray(T* data, std::size_t size)
+      : data_{data}, size_{size}
+  {}
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+  size_type size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  T const& operator[](size_type i) const { return data_[i]; }
+ private:
+  T* data_;
+  std::size_t size_;
+};
+
+// 一つの翻訳単位のノードを、大きなチャンクに詰めて確保する。
+// ノードのデストラクタは呼ばず、チャンクごとまとめて解放する。
+class Arena {
+ public:
+  explicit Arena(std::size_t chunk_size = 64 * 1024);
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+  void* allocate(std::size_t size, std::size_t alignment);
+  template <typename T, typename... Args>
+  NodePtr<T> make(Args&&... args) {
+    void* p = allocate(sizeof(T), alignof(T));
+    return NodePtr<T>(new (p) T(std::forward<Args>(args)...));
+  }
+  template <typename T>
+  NodeArray<T> make_array(std::vector<T>& elements) {
+    if (elements.empty()) {
+      return NodeArray<T>();
+    }
+    T* p = static_cast<T*>(allocate(sizeof(T) * elements.size(), alignof(T)));
+    std::uninitialized_copy(std::make_move_iterator(elements.begin()),
+                            std::make_move_iterator(elements.end()),
+                            p);
+    return NodeArray<T>(p, elements.size());
+  }
+  StringRef copy(StringRef str);
+  // other のチャンクを引き取る。other に置かれたノードはそのまま使える。
+  void merge(Arena& other);
+  std::size_t size() const { return size_; }
+  std::size_t chunk_count() const { return chunks_.size(); }
+ private:
+  void grow(std::size_t size);
+  std::vector<std::unique_ptr<char[]>> chunks_;
+  std::size_t chunk_size_;
+  char* current_;
+  char* end_;
+  std::size_t size_;
+};
+
+using ArenaPtr = std::shared_ptr<Arena>;
+
+}  // namespace ast
+}  // namespace klang
+
+#endif  // KMC_KLANG_ARENA_HPP
@@ -3,6 +3,8 @@
 
 #include "memory.hpp"
 
+#include <cstdint>
+
 namespace klang {
 namespace ast {
 
@@ -42,216 +44,387 @@ class ParameterList;
 class Parameter;
 class PrimaryExpression;
 
-using BasePtr = std::unique_ptr<Base>;
-using IdentifierPtr = std::unique_ptr<Identifier>;
-using TypePtr = std::unique_ptr<Type>;
-using IntegerLiteralPtr = std::unique_ptr<IntegerLiteral>;
-using CharacterLiteralPtr = std::unique_ptr<CharacterLiteral>;
-using StringLiteralPtr = std::unique_ptr<StringLiteral>;
+// 翻訳単位以外のノードは Arena の上に置かれ、Arena ごとまとめて解放される。
+// そのため、ノードを指すポインタは何も解放しない。
+struct NodeDeleter {
+  template <typename T>
+  void operator()(T*) const {}
+};
+
+template <typename T>
+using NodePtr = std::unique_ptr<T, NodeDeleter>;
+
+using BasePtr = NodePtr<Base>;
+using IdentifierPtr = NodePtr<Identifier>;
+using TypePtr = NodePtr<Type>;
+using IntegerLiteralPtr = NodePtr<IntegerLiteral>;
+using CharacterLiteralPtr = NodePtr<CharacterLiteral>;
+using StringLiteralPtr = NodePtr<StringLiteral>;
 using TranslationUnitPtr = std::unique_ptr<TranslationUnit>;
-using FunctionDefinitionPtr = std::unique_ptr<FunctionDefinition>;
-using ArgumentListPtr = std::unique_ptr<ArgumentList>;
-using ArgumentPtr = std::unique_ptr<Argument>;
-using StatementPtr = std::unique_ptr<Statement>;
-using CompoundStatementPtr = std::unique_ptr<CompoundStatement>;
-using IfStatementPtr = std::unique_ptr<IfStatement>;
-using ElseStatementPtr = std::unique_ptr<ElseStatement>;
-using WhileStatementPtr = std::unique_ptr<WhileStatement>;
-using ForStatementPtr = std::unique_ptr<ForStatement>;
-using ReturnStatementPtr = std::unique_ptr<ReturnStatement>;
-using BreakStatementPtr = std::unique_ptr<BreakStatement>;
-using ContinueStatementPtr = std::unique_ptr<ContinueStatement>;
-using VariableDefinitionStatementPtr =
-    std::unique_ptr<VariableDefinitionStatement>;
-using VariableDefinitionPtr = std::unique_ptr<VariableDefinition>;
-using ExpressionStatementPtr = std::unique_ptr<ExpressionStatement>;
-using ExpressionPtr = std::unique_ptr<Expression>;
-using AssignExpressionPtr = std::unique_ptr<AssignExpression>;
-using OrExpressionPtr = std::unique_ptr<OrExpression>;
-using AndExpressionPtr = std::unique_ptr<AndExpression>;
-using ComparativeExpressionPtr = std::unique_ptr<ComparativeExpression>;
-using AdditiveExpressionPtr = std::unique_ptr<AdditiveExpression>;
-using MultiplicativeExpressionPtr = std::unique_ptr<MultiplicativeExpression>;
-using UnaryExpressionPtr = std::unique_ptr<UnaryExpression>;
-using PostfixExpressionPtr = std::unique_ptr<PostfixExpression>;
-using FunctionCallExpressionPtr = std::unique_ptr<FunctionCallExpression>;
-using ParameterListPtr = std::unique_ptr<ParameterList>;
-using ParameterPtr = std::unique_ptr<Parameter>;
-using PrimaryExpressionPtr = std::unique_ptr<PrimaryExpression>;
+using FunctionDefinitionPtr = NodePtr<FunctionDefinition>;
+using ArgumentListPtr = NodePtr<ArgumentList>;
+using ArgumentPtr = NodePtr<Argument>;
+using StatementPtr = NodePtr<Statement>;
+using CompoundStatementPtr = NodePtr<CompoundStatement>;
+using IfStatementPtr = NodePtr<IfStatement>;
+using ElseStatementPtr = NodePtr<ElseStatement>;
+using WhileStatementPtr = NodePtr<WhileStatement>;
+using ForStatementPtr = NodePtr<ForStatement>;
+using ReturnStatementPtr = NodePtr<ReturnStatement>;
+using BreakStatementPtr = NodePtr<BreakStatement>;
+using ContinueStatementPtr = NodePtr<ContinueStatement>;
+using VariableDefinitionStatementPtr = NodePtr<VariableDefinitionStatement>;
+using VariableDefinitionPtr = NodePtr<VariableDefinition>;
+using ExpressionStatementPtr = NodePtr<ExpressionStatement>;
+using ExpressionPtr = NodePtr<Expression>;
+using AssignExpressionPtr = NodePtr<AssignExpression>;
+using OrExpressionPtr = NodePtr<OrExpression>;
+using AndExpressionPtr = NodePtr<AndExpression>;
+using ComparativeExpressionPtr = NodePtr<ComparativeExpression>;
+using AdditiveExpressionPtr = NodePtr<AdditiveExpression>;
+using MultiplicativeExpressionPtr = NodePtr<MultiplicativeExpression>;
+using UnaryExpressionPtr = NodePtr<UnaryExpression>;
+using PostfixExpressionPtr = NodePtr<PostfixExpression>;
+using FunctionCallExpressionPtr = NodePtr<FunctionCallExpression>;
+using ParameterListPtr = NodePtr<ParameterList>;
+using ParameterPtr = NodePtr<Parameter>;
+using PrimaryExpressionPtr = NodePtr<PrimaryExpression>;
+
+// 具象ノードの種類。ast_data.hpp の *Data クラスと 1 対 1 に対応する。
+enum class NodeKind : std::uint8_t {
+  IDENTIFIER,
+  TYPE,
+  INTEGER_LITERAL,
+  CHARACTER_LITERAL,
+  STRING_LITERAL,
+  TRANSLATION_UNIT,
+  FUNCTION_DEFINITION,
+  ARGUMENT_LIST,
+  ARGUMENT,
+  COMPOUND_STATEMENT,
+  IF_STATEMENT,
+  ELSE_STATEMENT,
+  WHILE_STATEMENT,
+  FOR_STATEMENT,
+  RETURN_STATEMENT,
+  BREAK_STATEMENT,
+  CONTINUE_STATEMENT,
+  VARIABLE_DEFINITION_STATEMENT,
+  VARIABLE_DEFINITION,
+  EXPRESSION_STATEMENT,
+  ASSIGN_EXPRESSION,
+  ADD_ASSIGN_EXPRESSION,
+  SUBTRACT_ASSIGN_EXPRESSION,
+  MULTIPLY_ASSIGN_EXPRESSION,
+  DIVIDE_ASSIGN_EXPRESSION,
+  MODULO_ASSIGN_EXPRESSION,
+  OR_EXPRESSION,
+  AND_EXPRESSION,
+  EQUAL_EXPRESSION,
+  NOT_EQUAL_EXPRESSION,
+  LESS_EXPRESSION,
+  GREATER_EXPRESSION,
+  LESS_OR_EQUAL_EXPRESSION,
+  GREATER_OR_EQUAL_EXPRESSION,
+  ADD_EXPRESSION,
+  SUBTRACT_EXPRESSION,
+  MULTIPLY_EXPRESSION,
+  DIVIDE_EXPRESSION,
+  MODULO_EXPRESSION,
+  NOT_EXPRESSION,
+  MINUS_EXPRESSION,
+  FUNCTION_CALL_EXPRESSION,
+  PARAMETER_LIST,
+  PARAMETER,
+  PARENTHESIZED_EXPRESSION,
+  IDENTIFIER_EXPRESSION,
+  INTEGER_LITERAL_EXPRESSION,
+  CHARACTER_LITERAL_EXPRESSION,
+  STRING_LITERAL_EXPRESSION,
+};
 
 class Base {
  public:
   virtual ~Base() = 0;
+  NodeKind kind() const { return kind_; }
+
+ protected:
+  explicit Base(NodeKind kind) : kind_(kind) {}
+
+ private:
+  NodeKind kind_;
 };
 
 class Identifier : public Base {
  public:
   virtual ~Identifier() = 0;
+
+ protected:
+  explicit Identifier(NodeKind kind) : Base(kind) {}
 };
 
 class Type : public Base {
  public:
   virtual ~Type() = 0;
+
+ protected:
+  explicit Type(NodeKind kind) : Base(kind) {}
 };
 
 class IntegerLiteral : public Base {
  public:
   virtual ~IntegerLiteral() = 0;
+
+ protected:
+  explicit IntegerLiteral(NodeKind kind) : Base(kind) {}
 };
 
 class CharacterLiteral : public Base {
  public:
   virtual ~CharacterLiteral() = 0;
+
+ protected:
+  explicit CharacterLiteral(NodeKind kind) : Base(kind) {}
 };
 
 class StringLiteral : public Base {
  public:
   virtual ~StringLiteral() = 0;
+
+ protected:
+  explicit StringLiteral(NodeKind kind) : Base(kind) {}
 };
 
 class TranslationUnit : public Base {
  public:
   virtual ~TranslationUnit() = 0;
+
+ protected:
+  explicit TranslationUnit(NodeKind kind) : Base(kind) {}
 };
 
 class FunctionDefinition : public Base {
  public:
   virtual ~FunctionDefinition() = 0;
+
+ protected:
+  explicit FunctionDefinition(NodeKind kind) : Base(kind) {}
 };
 
 class ArgumentList : public Base {
  public:
   virtual ~ArgumentList() = 0;
+
+ protected:
+  explicit ArgumentList(NodeKind kind) : Base(kind) {}
 };
 
 class Argument : public Base {
  public:
   virtual ~Argument() = 0;
+
+ protected:
+  explicit Argument(NodeKind kind) : Base(kind) {}
 };
 
 class Statement : public Base {
  public:
   virtual ~Statement() = 0;
+
+ protected:
+  explicit Statement(NodeKind kind) : Base(kind) {}
 };
 
 class CompoundStatement : public Statement {
  public:
   virtual ~CompoundStatement() = 0;
+
+ protected:
+  explicit CompoundStatement(NodeKind kind) : Statement(kind) {}
 };
 
 class ElseStatement : public Statement {
  public:
   virtual ~ElseStatement() = 0;
+
+ protected:
+  explicit ElseStatement(NodeKind kind) : Statement(kind) {}
 };
 
 class IfStatement : public ElseStatement {
  public:
   virtual ~IfStatement() = 0;
+
+ protected:
+  explicit IfStatement(NodeKind kind) : ElseStatement(kind) {}
 };
 
 class WhileStatement : public Statement {
  public:
   virtual ~WhileStatement() = 0;
+
+ protected:
+  explicit WhileStatement(NodeKind kind) : Statement(kind) {}
 };
 
 class ForStatement : public Statement {
  public:
   virtual ~ForStatement() = 0;
+
+ protected:
+  explicit ForStatement(NodeKind kind) : Statement(kind) {}
 };
 
 class ReturnStatement : public Statement {
  public:
   virtual ~ReturnStatement() = 0;
+
+ protected:
+  explicit ReturnStatement(NodeKind kind) : Statement(kind) {}
 };
 
 class BreakStatement : public Statement {
  public:
   virtual ~BreakStatement() = 0;
+
+ protected:
+  explicit BreakStatement(NodeKind kind) : Statement(kind) {}
 };
 
 class ContinueStatement : public Statement {
  public:
   virtual ~ContinueStatement() = 0;
+
+ protected:
+  explicit ContinueStatement(NodeKind kind) : Statement(kind) {}
 };
 
 class VariableDefinitionStatement : public Statement {
  public:
   virtual ~VariableDefinitionStatement() = 0;
+
+ protected:
+  explicit VariableDefinitionStatement(NodeKind kind) : Statement(kind) {}
 };
 
 class VariableDefinition : public Base {
  public:
   virtual ~VariableDefinition() = 0;
+
+ protected:
+  explicit VariableDefinition(NodeKind kind) : Base(kind) {}
 };
 
 class ExpressionStatement : public Statement {
  public:
   virtual ~ExpressionStatement() = 0;
+
+ protected:
+  explicit ExpressionStatement(NodeKind kind) : Statement(kind) {}
 };
 
 class Expression : public Base {
  public:
   virtual ~Expression() = 0;
+
+ protected:
+  explicit Expression(NodeKind kind) : Base(kind) {}
 };
 
 class AssignExpression : public Expression {
  public:
   virtual ~AssignExpression() = 0;
+
+ protected:
+  explicit AssignExpression(NodeKind kind) : Expression(kind) {}
 };
 
 class OrExpression : public AssignExpression {
  public:
   virtual ~OrExpression() = 0;
+
+ protected:
+  explicit OrExpression(NodeKind kind) : AssignExpression(kind) {}
 };
 
 class AndExpression : public OrExpression {
  public:
   virtual ~AndExpression() = 0;
+
+ protected:
+  explicit AndExpression(NodeKind kind) : OrExpression(kind) {}
 };
 
 class ComparativeExpression : public AndExpression {
  public:
   virtual ~ComparativeExpression() = 0;
+
+ protected:
+  explicit ComparativeExpression(NodeKind kind) : AndExpression(kind) {}
 };
 
 class AdditiveExpression : public ComparativeExpression {
  public:
   virtual ~AdditiveExpression() = 0;
+
+ protected:
+  explicit AdditiveExpression(NodeKind kind) : ComparativeExpression(kind) {}
 };
 
 class MultiplicativeExpression : public AdditiveExpression {
  public:
   virtual ~MultiplicativeExpression() = 0;
+
+ protected:
+  explicit MultiplicativeExpression(NodeKind kind) : AdditiveExpression(kind) {}
 };
 
 class UnaryExpression : public MultiplicativeExpression {
  public:
   virtual ~UnaryExpression() = 0;
+
+ protected:
+  explicit UnaryExpression(NodeKind kind) : MultiplicativeExpression(kind) {}
 };
 
 class PostfixExpression : public UnaryExpression {
  public:
   virtual ~PostfixExpression() = 0;
+
+ protected:
+  explicit PostfixExpression(NodeKind kind) : UnaryExpression(kind) {}
 };
 
 class FunctionCallExpression : public PostfixExpression {
  public:
   virtual ~FunctionCallExpression() = 0;
+
+ protected:
+  explicit FunctionCallExpression(NodeKind kind) : PostfixExpression(kind) {}
 };
 
 class ParameterList : public Base {
  public:
   virtual ~ParameterList() = 0;
+
+ protected:
+  explicit ParameterList(NodeKind kind) : Base(kind) {}
 };
 
 class Parameter : public Base {
  public:
   virtual ~Parameter() = 0;
+
+ protected:
+  explicit Parameter(NodeKind kind) : Base(kind) {}
 };
 
 class PrimaryExpression : public PostfixExpression {
  public:
   virtual ~PrimaryExpression() = 0;
+
+ protected:
+  explicit PrimaryExpression(NodeKind kind) : PostfixExpression(kind) {}
 };
 
 }  // namespace ast
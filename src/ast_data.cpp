@@ -3,71 +3,104 @@
 namespace klang {
 namespace ast {
 
-IdentifierData::IdentifierData(const std::string& value)
-    : value_(value)
+IdentifierData::IdentifierData(Interner::Id id, std::uint32_t offset)
+    : Identifier(NodeKind::IDENTIFIER),
+      id_(id), offset_(offset)
 {}
 
-TypeData::TypeData(const std::string& value)
-    : value_(value)
+StringRef IdentifierData::value() const {
+  return Interner::global().str(id_);
+}
+
+TypeData::TypeData(Interner::Id id, std::uint32_t offset)
+    : Type(NodeKind::TYPE),
+      id_(id), offset_(offset)
 {}
 
-IntegerLiteralData::IntegerLiteralData(const std::string& value)
-    : value_(value)
+StringRef TypeData::value() const {
+  return Interner::global().str(id_);
+}
+
+IntegerLiteralData::IntegerLiteralData(StringRef value)
+    : IntegerLiteral(NodeKind::INTEGER_LITERAL),
+      value_(value)
 {}
 
-CharacterLiteralData::CharacterLiteralData(const std::string& value)
-    : value_(value)
+CharacterLiteralData::CharacterLiteralData(StringRef value)
+    : CharacterLiteral(NodeKind::CHARACTER_LITERAL),
+      value_(value)
 {}
 
-StringLiteralData::StringLiteralData(const std::string& value)
-    : value_(value)
+StringLiteralData::StringLiteralData(StringRef value)
+    : StringLiteral(NodeKind::STRING_LITERAL),
+      value_(value)
 {}
 
 TranslationUnitData::TranslationUnitData(
-    std::vector<FunctionDefinitionPtr> functions)
-    : functions_(std::move(functions)) {
+    ArenaPtr arena, std::vector<FunctionDefinitionPtr> functions,
+    std::vector<TokenRange> ranges)
+    : TranslationUnit(NodeKind::TRANSLATION_UNIT),
+      arena_(std::move(arena)),
+      functions_(std::move(functions)),
+      ranges_(std::move(ranges)) {
+}
+
+std::vector<FunctionDefinitionPtr> TranslationUnitData::release_functions() {
+  std::vector<FunctionDefinitionPtr> functions;
+  functions.swap(functions_);
+  ranges_.clear();
+  return functions;
 }
 
 FunctionDefinitionData::FunctionDefinitionData(
+    std::uint32_t offset,
     IdentifierPtr name,
     ArgumentListPtr arguments,
     TypePtr return_type,
     CompoundStatementPtr body)
-    : name_(std::move(name)),
+    : FunctionDefinition(NodeKind::FUNCTION_DEFINITION),
+      offset_(offset),
+      name_(std::move(name)),
       arguments_(std::move(arguments)),
       return_type_(std::move(return_type)),
       body_(std::move(body))
 {}
 
-ArgumentListData::ArgumentListData(std::vector<ArgumentPtr> arguments)
-    : arguments_(std::move(arguments))
+ArgumentListData::ArgumentListData(NodeArray<ArgumentPtr> arguments)
+    : ArgumentList(NodeKind::ARGUMENT_LIST),
+      arguments_(std::move(arguments))
 {}
 
 ArgumentData::ArgumentData(TypePtr type, IdentifierPtr name)
-    : type_(std::move(type)),
+    : Argument(NodeKind::ARGUMENT),
+      type_(std::move(type)),
       name_(std::move(name))
 {}
 
 CompoundStatementData::CompoundStatementData(
-    std::vector<StatementPtr> statements)
-    : statements_(std::move(statements))
+    NodeArray<StatementPtr> statements)
+    : CompoundStatement(NodeKind::COMPOUND_STATEMENT),
+      statements_(std::move(statements))
 {}
 
 IfStatementData::IfStatementData(ExpressionPtr condition,
                                  CompoundStatementPtr body,
                                  ElseStatementPtr else_block)
-    : condition_(std::move(condition)),
+    : IfStatement(NodeKind::IF_STATEMENT),
+      condition_(std::move(condition)),
       body_(std::move(body)),
       else_block_(std::move(else_block))
 {}
 
 ElseStatementData::ElseStatementData(CompoundStatementPtr body)
-    : body_(std::move(body))
+    : ElseStatement(NodeKind::ELSE_STATEMENT),
+      body_(std::move(body))
 {}
 
 WhileStatementData::WhileStatementData(ExpressionPtr condition,
                                        CompoundStatementPtr body)
-    : condition_(std::move(condition)),
+    : WhileStatement(NodeKind::WHILE_STATEMENT),
+      condition_(std::move(condition)),
       body_(std::move(body))
 {}
 
@@ -75,25 +108,30 @@ ForStatementData::ForStatementData(ExpressionPtr initialize,
                                    ExpressionPtr condition,
                                    ExpressionPtr reinitialize,
                                    CompoundStatementPtr body)
-    : initialize_(std::move(initialize)),
+    : ForStatement(NodeKind::FOR_STATEMENT),
+      initialize_(std::move(initialize)),
       condition_(std::move(condition)),
       reinitialize_(std::move(reinitialize)),
       body_(std::move(body))
 {}
 
 ReturnStatementData::ReturnStatementData(ExpressionPtr return_value)
-    : return_value_(std::move(return_value))
+    : ReturnStatement(NodeKind::RETURN_STATEMENT),
+      return_value_(std::move(return_value))
 {}
 
 BreakStatementData::BreakStatementData()
+    : BreakStatement(NodeKind::BREAK_STATEMENT)
 {}
 
 ContinueStatementData::ContinueStatementData()
+    : ContinueStatement(NodeKind::CONTINUE_STATEMENT)
 {}
 
 VariableDefinitionStatementData::VariableDefinitionStatementData(
     VariableDefinitionPtr body)
-    : body_(std::move(body))
+    : VariableDefinitionStatement(NodeKind::VARIABLE_DEFINITION_STATEMENT),
+      body_(std::move(body))
 {}
 
 VariableDefinitionData::VariableDefinitionData(
@@ -101,174 +139,205 @@ VariableDefinitionData::VariableDefinitionData(
     bool is_mutable,
     IdentifierPtr variable_name,
     ExpressionPtr expression)
-    : type_name_(std::move(type_name)),
+    : VariableDefinition(NodeKind::VARIABLE_DEFINITION),
+      type_name_(std::move(type_name)),
       is_mutable_(is_mutable),
       variable_name_(std::move(variable_name)),
       expression_(std::move(expression))
 {}
 
 ExpressionStatementData::ExpressionStatementData(ExpressionPtr body)
-    : body_(std::move(body))
+    : ExpressionStatement(NodeKind::EXPRESSION_STATEMENT),
+      body_(std::move(body))
 {}
 
 AssignExpressionData::AssignExpressionData(
     OrExpressionPtr lhs, OrExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : AssignExpression(NodeKind::ASSIGN_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 AddAssignExpressionData::AddAssignExpressionData(
     OrExpressionPtr lhs, OrExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : AssignExpression(NodeKind::ADD_ASSIGN_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 SubtractAssignExpressionData::SubtractAssignExpressionData(
     OrExpressionPtr lhs, OrExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : AssignExpression(NodeKind::SUBTRACT_ASSIGN_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 MultiplyAssignExpressionData::MultiplyAssignExpressionData(
     OrExpressionPtr lhs, OrExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : AssignExpression(NodeKind::MULTIPLY_ASSIGN_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 DivideAssignExpressionData::DivideAssignExpressionData(
     OrExpressionPtr lhs, OrExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : AssignExpression(NodeKind::DIVIDE_ASSIGN_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 ModuloAssignExpressionData::ModuloAssignExpressionData(
     OrExpressionPtr lhs, OrExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : AssignExpression(NodeKind::MODULO_ASSIGN_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 OrExpressionData::OrExpressionData(
-    AndExpressionPtr lhs, OrExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    OrExpressionPtr lhs, AndExpressionPtr rhs)
+    : OrExpression(NodeKind::OR_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 AndExpressionData::AndExpressionData(
-    ComparativeExpressionPtr lhs, AndExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    AndExpressionPtr lhs, ComparativeExpressionPtr rhs)
+    : AndExpression(NodeKind::AND_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 EqualExpressionData::EqualExpressionData(
     AdditiveExpressionPtr lhs, AdditiveExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : ComparativeExpression(NodeKind::EQUAL_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 NotEqualExpressionData::NotEqualExpressionData(
     AdditiveExpressionPtr lhs, AdditiveExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : ComparativeExpression(NodeKind::NOT_EQUAL_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 LessExpressionData::LessExpressionData(
     AdditiveExpressionPtr lhs, AdditiveExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : ComparativeExpression(NodeKind::LESS_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 GreaterExpressionData::GreaterExpressionData(
     AdditiveExpressionPtr lhs, AdditiveExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : ComparativeExpression(NodeKind::GREATER_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 LessOrEqualExpressionData::LessOrEqualExpressionData(
     AdditiveExpressionPtr lhs, AdditiveExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : ComparativeExpression(NodeKind::LESS_OR_EQUAL_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 GreaterOrEqualExpressionData::GreaterOrEqualExpressionData(
     AdditiveExpressionPtr lhs, AdditiveExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    : ComparativeExpression(NodeKind::GREATER_OR_EQUAL_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 AddExpressionData::AddExpressionData(
-    MultiplicativeExpressionPtr lhs, AdditiveExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    AdditiveExpressionPtr lhs, MultiplicativeExpressionPtr rhs)
+    : AdditiveExpression(NodeKind::ADD_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 SubtractExpressionData::SubtractExpressionData(
-    MultiplicativeExpressionPtr lhs, AdditiveExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    AdditiveExpressionPtr lhs, MultiplicativeExpressionPtr rhs)
+    : AdditiveExpression(NodeKind::SUBTRACT_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 MultiplyExpressionData::MultiplyExpressionData(
-    UnaryExpressionPtr lhs, MultiplicativeExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    MultiplicativeExpressionPtr lhs, UnaryExpressionPtr rhs)
+    : MultiplicativeExpression(NodeKind::MULTIPLY_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 DivideExpressionData::DivideExpressionData(
-    UnaryExpressionPtr lhs, MultiplicativeExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    MultiplicativeExpressionPtr lhs, UnaryExpressionPtr rhs)
+    : MultiplicativeExpression(NodeKind::DIVIDE_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 ModuloExpressionData::ModuloExpressionData(
-    UnaryExpressionPtr lhs, MultiplicativeExpressionPtr rhs)
-    : lhs_(std::move(lhs)),
+    MultiplicativeExpressionPtr lhs, UnaryExpressionPtr rhs)
+    : MultiplicativeExpression(NodeKind::MODULO_EXPRESSION),
+      lhs_(std::move(lhs)),
       rhs_(std::move(rhs))
 {}
 
 NotExpressionData::NotExpressionData(UnaryExpressionPtr expression)
-    : expression_(std::move(expression))
+    : UnaryExpression(NodeKind::NOT_EXPRESSION),
+      expression_(std::move(expression))
 {}
 
 MinusExpressionData::MinusExpressionData(UnaryExpressionPtr expression)
-    : expression_(std::move(expression))
+    : UnaryExpression(NodeKind::MINUS_EXPRESSION),
+      expression_(std::move(expression))
 {}
 
 FunctionCallExpressionData::FunctionCallExpressionData(
     IdentifierPtr function_name, ParameterListPtr parameter_list)
-    : function_name_(std::move(function_name)),
+    : FunctionCallExpression(NodeKind::FUNCTION_CALL_EXPRESSION),
+      function_name_(std::move(function_name)),
       parameter_list_(std::move(parameter_list))
 {}
 
-ParameterListData::ParameterListData(std::vector<ParameterPtr> parameters)
-    : parameters_(std::move(parameters))
+ParameterListData::ParameterListData(NodeArray<ParameterPtr> parameters)
+    : ParameterList(NodeKind::PARAMETER_LIST),
+      parameters_(std::move(parameters))
 {}
 
 ParameterData::ParameterData(ExpressionPtr expression)
-    : expression_(std::move(expression))
+    : Parameter(NodeKind::PARAMETER),
+      expression_(std::move(expression))
 {}
 
 ParenthesizedExpressionData::ParenthesizedExpressionData(
     ExpressionPtr expression)
-    : expression_(std::move(expression))
+    : PrimaryExpression(NodeKind::PARENTHESIZED_EXPRESSION),
+      expression_(std::move(expression))
 {}
 
 IdentifierExpressionData::IdentifierExpressionData(IdentifierPtr expression)
-    : expression_(std::move(expression))
+    : PrimaryExpression(NodeKind::IDENTIFIER_EXPRESSION),
+      expression_(std::move(expression))
 {}
 
 IntegerLiteralExpressionData::IntegerLiteralExpressionData(
     IntegerLiteralPtr expression)
-    : expression_(std::move(expression))
+    : PrimaryExpression(NodeKind::INTEGER_LITERAL_EXPRESSION),
+      expression_(std::move(expression))
 {}
 
 CharacterLiteralExpressionData::CharacterLiteralExpressionData(
     CharacterLiteralPtr expression)
-    : expression_(std::move(expression))
+    : PrimaryExpression(NodeKind::CHARACTER_LITERAL_EXPRESSION),
+      expression_(std::move(expression))
 {}
 
 StringLiteralExpressionData::StringLiteralExpressionData(
     StringLiteralPtr expression)
-    : expression_(std::move(expression))
+    : PrimaryExpression(NodeKind::STRING_LITERAL_EXPRESSION),
+      expression_(std::move(expression))
 {}
 
 }  // namespace ast
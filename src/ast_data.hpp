@@ -1,74 +1,112 @@
 #ifndef KMC_KLANG_AST_DATA_HPP
 #define KMC_KLANG_AST_DATA_HPP
 
+#include "arena.hpp"
 #include "ast.hpp"
-#include <string>
+#include "interner.hpp"
+#include "string_ref.hpp"
+#include <cstddef>
+#include <cstdint>
 #include <vector>
 
 namespace klang {
 namespace ast {
 
+// 名前は Interner::global() での番号で持つ。同じ名前かどうかは番号を比べればよい。
 class IdentifierData : public Identifier {
  public:
-  IdentifierData(const std::string& value);
-  std::string const& value() const { return value_; }
+  IdentifierData(Interner::Id id, std::uint32_t offset);
+  Interner::Id id() const { return id_; }
+  // 関数定義の中では、その FunctionDefinitionData::offset() からの距離。
+  // 関数の外で読んだものはソース上の位置そのもの。
+  std::uint32_t offset() const { return offset_; }
+  StringRef value() const;
  private:
-  std::string value_;
+  Interner::Id id_;
+  std::uint32_t offset_;
 };
 
 class TypeData : public Type {
  public:
-  TypeData(const std::string& value);
-  std::string const& value() const { return value_; }
+  TypeData(Interner::Id id, std::uint32_t offset);
+  Interner::Id id() const { return id_; }
+  // IdentifierData::offset() と同じく、関数定義の先頭からの距離。
+  std::uint32_t offset() const { return offset_; }
+  StringRef value() const;
  private:
-  std::string value_;
+  Interner::Id id_;
+  std::uint32_t offset_;
 };
 
 class IntegerLiteralData : public IntegerLiteral {
  public:
-  IntegerLiteralData(const std::string& value);
-  std::string const& value() const { return value_; }
+  IntegerLiteralData(StringRef value);
+  StringRef value() const { return value_; }
  private:
-  std::string value_;
+  StringRef value_;
 };
 
 class CharacterLiteralData : public CharacterLiteral {
  public:
-  CharacterLiteralData(const std::string& value);
-  std::string const& value() const { return value_; }
+  CharacterLiteralData(StringRef value);
+  StringRef value() const { return value_; }
  private:
-  std::string value_;
+  StringRef value_;
 };
 
 class StringLiteralData : public StringLiteral {
  public:
-  StringLiteralData(const std::string& value);
-  std::string const& value() const { return value_; }
+  StringLiteralData(StringRef value);
+  StringRef value() const { return value_; }
  private:
-  std::string value_;
+  StringRef value_;
+};
+
+// トークン列上の [begin, end) の範囲。
+struct TokenRange {
+  std::size_t begin;
+  std::size_t end;
 };
 
 class TranslationUnitData : public TranslationUnit {
  public:
-  TranslationUnitData(std::vector<FunctionDefinitionPtr> functions);
+  // ranges は空か、関数定義ごとにそれを読んだトークンの範囲を持つ。
+  TranslationUnitData(ArenaPtr arena,
+                      std::vector<FunctionDefinitionPtr> functions,
+                      std::vector<TokenRange> ranges = {});
   std::vector<FunctionDefinitionPtr> const& functions() const {
     return functions_;
   }
+  std::vector<TokenRange> const& ranges() const { return ranges_; }
+  ArenaPtr const& arena() const { return arena_; }
+  // 関数定義を取り出す。ノードは arena() に残る。
+  std::vector<FunctionDefinitionPtr> release_functions();
  private:
+  // 関数定義より後に破棄されるよう、先に宣言する。
+  ArenaPtr arena_;
   std::vector<FunctionDefinitionPtr> functions_;
+  std::vector<TokenRange> ranges_;
 };
 
 class FunctionDefinitionData : public FunctionDefinition {
  public:
-  FunctionDefinitionData(IdentifierPtr name,
+  FunctionDefinitionData(std::uint32_t offset,
+                         IdentifierPtr name,
                          ArgumentListPtr arguments,
                          TypePtr return_type,
                          CompoundStatementPtr body);
+  // 先頭の def のソース上の位置。中の名前の位置はここからの距離で持つので、
+  // 読み直しで関数ごと動かすときはここだけを書き換える。
+  std::uint32_t offset() const { return offset_; }
+  void shift(std::int64_t delta) {
+    offset_ = static_cast<std::uint32_t>(offset_ + delta);
+  }
   IdentifierPtr const& name() const { return name_; }
   ArgumentListPtr const& arguments() const { return arguments_; }
   TypePtr const& return_type() const { return return_type_; }
   CompoundStatementPtr const& body() const { return body_; }
  private:
+  std::uint32_t offset_;
   IdentifierPtr name_;
   ArgumentListPtr arguments_;
   TypePtr return_type_;
@@ -77,10 +115,10 @@ class FunctionDefinitionData : public FunctionDefinition {
 
 class ArgumentListData : public ArgumentList {
  public:
-  ArgumentListData(std::vector<ArgumentPtr> arguments);
-  std::vector<ArgumentPtr> const& arguments() const { return arguments_; }
+  ArgumentListData(NodeArray<ArgumentPtr> arguments);
+  NodeArray<ArgumentPtr> const& arguments() const { return arguments_; }
  private:
-  std::vector<ArgumentPtr> arguments_;
+  NodeArray<ArgumentPtr> arguments_;
 };
 
 class ArgumentData : public Argument {
@@ -95,10 +133,10 @@ class ArgumentData : public Argument {
 
 class CompoundStatementData : public CompoundStatement {
  public:
-  CompoundStatementData(std::vector<StatementPtr> statements);
-  std::vector<StatementPtr> const& statements() const { return statements_; }
+  CompoundStatementData(NodeArray<StatementPtr> statements);
+  NodeArray<StatementPtr> const& statements() const { return statements_; }
  private:
-  std::vector<StatementPtr> statements_;
+  NodeArray<StatementPtr> statements_;
 };
 
 class IfStatementData : public IfStatement {
@@ -270,24 +308,24 @@ class ModuloAssignExpressionData : public AssignExpression {
 
 class OrExpressionData : public OrExpression {
  public:
-  OrExpressionData(AndExpressionPtr lhs,
-                   OrExpressionPtr rhs);
-  AndExpressionPtr const& lhs() const { return lhs_; }
-  OrExpressionPtr const& rhs() const { return rhs_; }
+  OrExpressionData(OrExpressionPtr lhs,
+                   AndExpressionPtr rhs);
+  OrExpressionPtr const& lhs() const { return lhs_; }
+  AndExpressionPtr const& rhs() const { return rhs_; }
  private:
-  AndExpressionPtr lhs_;
-  OrExpressionPtr rhs_;
+  OrExpressionPtr lhs_;
+  AndExpressionPtr rhs_;
 };
 
 class AndExpressionData : public AndExpression {
  public:
-  AndExpressionData(ComparativeExpressionPtr lhs,
-                    AndExpressionPtr rhs);
-  ComparativeExpressionPtr const& lhs() const { return lhs_; }
-  AndExpressionPtr const& rhs() const { return rhs_; }
+  AndExpressionData(AndExpressionPtr lhs,
+                    ComparativeExpressionPtr rhs);
+  AndExpressionPtr const& lhs() const { return lhs_; }
+  ComparativeExpressionPtr const& rhs() const { return rhs_; }
  private:
-  ComparativeExpressionPtr lhs_;
-  AndExpressionPtr rhs_;
+  AndExpressionPtr lhs_;
+  ComparativeExpressionPtr rhs_;
 };
 
 class EqualExpressionData : public ComparativeExpression {
@@ -358,57 +396,57 @@ class GreaterOrEqualExpressionData : public ComparativeExpression {
 
 class AddExpressionData : public AdditiveExpression {
  public:
-  AddExpressionData(MultiplicativeExpressionPtr lhs,
-                    AdditiveExpressionPtr rhs);
-  MultiplicativeExpressionPtr const& lhs() const { return lhs_; }
-  AdditiveExpressionPtr const& rhs() const { return rhs_; }
+  AddExpressionData(AdditiveExpressionPtr lhs,
+                    MultiplicativeExpressionPtr rhs);
+  AdditiveExpressionPtr const& lhs() const { return lhs_; }
+  MultiplicativeExpressionPtr const& rhs() const { return rhs_; }
  private:
-  MultiplicativeExpressionPtr lhs_;
-  AdditiveExpressionPtr rhs_;
+  AdditiveExpressionPtr lhs_;
+  MultiplicativeExpressionPtr rhs_;
 };
 
 class SubtractExpressionData : public AdditiveExpression {
  public:
-  SubtractExpressionData(MultiplicativeExpressionPtr lhs,
-                         AdditiveExpressionPtr rhs);
-  MultiplicativeExpressionPtr const& lhs() const { return lhs_; }
-  AdditiveExpressionPtr const& rhs() const { return rhs_; }
+  SubtractExpressionData(AdditiveExpressionPtr lhs,
+                         MultiplicativeExpressionPtr rhs);
+  AdditiveExpressionPtr const& lhs() const { return lhs_; }
+  MultiplicativeExpressionPtr const& rhs() const { return rhs_; }
  private:
-  MultiplicativeExpressionPtr lhs_;
-  AdditiveExpressionPtr rhs_;
+  AdditiveExpressionPtr lhs_;
+  MultiplicativeExpressionPtr rhs_;
 };
 
 class MultiplyExpressionData : public MultiplicativeExpression {
  public:
-  MultiplyExpressionData(UnaryExpressionPtr lhs,
-                         MultiplicativeExpressionPtr rhs);
-  UnaryExpressionPtr const& lhs() const { return lhs_; }
-  MultiplicativeExpressionPtr const& rhs() const { return rhs_; }
+  MultiplyExpressionData(MultiplicativeExpressionPtr lhs,
+                         UnaryExpressionPtr rhs);
+  MultiplicativeExpressionPtr const& lhs() const { return lhs_; }
+  UnaryExpressionPtr const& rhs() const { return rhs_; }
  private:
-  UnaryExpressionPtr lhs_;
-  MultiplicativeExpressionPtr rhs_;
+  MultiplicativeExpressionPtr lhs_;
+  UnaryExpressionPtr rhs_;
 };
 
 class DivideExpressionData : public MultiplicativeExpression {
  public:
-  DivideExpressionData(UnaryExpressionPtr lhs,
-                       MultiplicativeExpressionPtr rhs);
-  UnaryExpressionPtr const& lhs() const { return lhs_; }
-  MultiplicativeExpressionPtr const& rhs() const { return rhs_; }
+  DivideExpressionData(MultiplicativeExpressionPtr lhs,
+                       UnaryExpressionPtr rhs);
+  MultiplicativeExpressionPtr const& lhs() const { return lhs_; }
+  UnaryExpressionPtr const& rhs() const { return rhs_; }
  private:
-  UnaryExpressionPtr lhs_;
-  MultiplicativeExpressionPtr rhs_;
+  MultiplicativeExpressionPtr lhs_;
+  UnaryExpressionPtr rhs_;
 };
 
 class ModuloExpressionData : public MultiplicativeExpression {
  public:
-  ModuloExpressionData(UnaryExpressionPtr lhs,
-                       MultiplicativeExpressionPtr rhs);
-  UnaryExpressionPtr const& lhs() const { return lhs_; }
-  MultiplicativeExpressionPtr const& rhs() const { return rhs_; }
+  ModuloExpressionData(MultiplicativeExpressionPtr lhs,
+                       UnaryExpressionPtr rhs);
+  MultiplicativeExpressionPtr const& lhs() const { return lhs_; }
+  UnaryExpressionPtr const& rhs() const { return rhs_; }
  private:
-  UnaryExpressionPtr lhs_;
-  MultiplicativeExpressionPtr rhs_;
+  MultiplicativeExpressionPtr lhs_;
+  UnaryExpressionPtr rhs_;
 };
 
 class NotExpressionData : public UnaryExpression {
@@ -440,10 +478,10 @@ class FunctionCallExpressionData : public FunctionCallExpression {
 
 class ParameterListData : public ParameterList {
  public:
-  ParameterListData(std::vector<ParameterPtr> parameters);
-  std::vector<ParameterPtr> const& parameters() const { return parameters_; }
+  ParameterListData(NodeArray<ParameterPtr> parameters);
+  NodeArray<ParameterPtr> const& parameters() const { return parameters_; }
  private:
-  std::vector<ParameterPtr> parameters_;
+  NodeArray<ParameterPtr> parameters_;
 };
 
 class ParameterData : public Parameter {
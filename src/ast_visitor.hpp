@@ -0,0 +1,409 @@
+#ifndef KMC_KLANG_AST_VISITOR_HPP
+#define KMC_KLANG_AST_VISITOR_HPP
+
+#include "ast.hpp"
+#include "ast_data.hpp"
+
+namespace klang {
+namespace ast {
+
+// 構文木を辿る CRTP の訪問者。visit は kind() の switch 一つで具象型に
+// 振り分けるので、dynamic_cast の連鎖も仮想関数の呼び出しも要らない。
+// 派生クラスは必要な visit_* だけを同じ名前で定義する。定義しなかった
+// ものは子を順に訪れる。visit を定義し直すと、すべてのノードの前で
+// 呼ばれる。その場合は最後に Visitor<Derived>::visit を呼ぶ。
+template <typename Derived>
+class Visitor {
+ public:
+  void visit(Base const& node) {
+    switch (node.kind()) {
+      case NodeKind::IDENTIFIER:
+        return derived().visit_identifier(
+            static_cast<IdentifierData const&>(node));
+      case NodeKind::TYPE:
+        return derived().visit_type(
+            static_cast<TypeData const&>(node));
+      case NodeKind::INTEGER_LITERAL:
+        return derived().visit_integer_literal(
+            static_cast<IntegerLiteralData const&>(node));
+      case NodeKind::CHARACTER_LITERAL:
+        return derived().visit_character_literal(
+            static_cast<CharacterLiteralData const&>(node));
+      case NodeKind::STRING_LITERAL:
+        return derived().visit_string_literal(
+            static_cast<StringLiteralData const&>(node));
+      case NodeKind::TRANSLATION_UNIT:
+        return derived().visit_translation_unit(
+            static_cast<TranslationUnitData const&>(node));
+      case NodeKind::FUNCTION_DEFINITION:
+        return derived().visit_function_definition(
+            static_cast<FunctionDefinitionData const&>(node));
+      case NodeKind::ARGUMENT_LIST:
+        return derived().visit_argument_list(
+            static_cast<ArgumentListData const&>(node));
+      case NodeKind::ARGUMENT:
+        return derived().visit_argument(
+            static_cast<ArgumentData const&>(node));
+      case NodeKind::COMPOUND_STATEMENT:
+        return derived().visit_compound_statement(
+            static_cast<CompoundStatementData const&>(node));
+      case NodeKind::IF_STATEMENT:
+        return derived().visit_if_statement(
+            static_cast<IfStatementData const&>(node));
+      case NodeKind::ELSE_STATEMENT:
+        return derived().visit_else_statement(
+            static_cast<ElseStatementData const&>(node));
+      case NodeKind::WHILE_STATEMENT:
+        return derived().visit_while_statement(
+            static_cast<WhileStatementData const&>(node));
+      case NodeKind::FOR_STATEMENT:
+        return derived().visit_for_statement(
+            static_cast<ForStatementData const&>(node));
+      case NodeKind::RETURN_STATEMENT:
+        return derived().visit_return_statement(
+            static_cast<ReturnStatementData const&>(node));
+      case NodeKind::BREAK_STATEMENT:
+        return derived().visit_break_statement(
+            static_cast<BreakStatementData const&>(node));
+      case NodeKind::CONTINUE_STATEMENT:
+        return derived().visit_continue_statement(
+            static_cast<ContinueStatementData const&>(node));
+      case NodeKind::VARIABLE_DEFINITION_STATEMENT:
+        return derived().visit_variable_definition_statement(
+            static_cast<VariableDefinitionStatementData const&>(node));
+      case NodeKind::VARIABLE_DEFINITION:
+        return derived().visit_variable_definition(
+            static_cast<VariableDefinitionData const&>(node));
+      case NodeKind::EXPRESSION_STATEMENT:
+        return derived().visit_expression_statement(
+            static_cast<ExpressionStatementData const&>(node));
+      case NodeKind::ASSIGN_EXPRESSION:
+        return derived().visit_assign_expression(
+            static_cast<AssignExpressionData const&>(node));
+      case NodeKind::ADD_ASSIGN_EXPRESSION:
+        return derived().visit_add_assign_expression(
+            static_cast<AddAssignExpressionData const&>(node));
+      case NodeKind::SUBTRACT_ASSIGN_EXPRESSION:
+        return derived().visit_subtract_assign_expression(
+            static_cast<SubtractAssignExpressionData const&>(node));
+      case NodeKind::MULTIPLY_ASSIGN_EXPRESSION:
+        return derived().visit_multiply_assign_expression(
+            static_cast<MultiplyAssignExpressionData const&>(node));
+      case NodeKind::DIVIDE_ASSIGN_EXPRESSION:
+        return derived().visit_divide_assign_expression(
+            static_cast<DivideAssignExpressionData const&>(node));
+      case NodeKind::MODULO_ASSIGN_EXPRESSION:
+        return derived().visit_modulo_assign_expression(
+            static_cast<ModuloAssignExpressionData const&>(node));
+      case NodeKind::OR_EXPRESSION:
+        return derived().visit_or_expression(
+            static_cast<OrExpressionData const&>(node));
+      case NodeKind::AND_EXPRESSION:
+        return derived().visit_and_expression(
+            static_cast<AndExpressionData const&>(node));
+      case NodeKind::EQUAL_EXPRESSION:
+        return derived().visit_equal_expression(
+            static_cast<EqualExpressionData const&>(node));
+      case NodeKind::NOT_EQUAL_EXPRESSION:
+        return derived().visit_not_equal_expression(
+            static_cast<NotEqualExpressionData const&>(node));
+      case NodeKind::LESS_EXPRESSION:
+        return derived().visit_less_expression(
+            static_cast<LessExpressionData const&>(node));
+      case NodeKind::GREATER_EXPRESSION:
+        return derived().visit_greater_expression(
+            static_cast<GreaterExpressionData const&>(node));
+      case NodeKind::LESS_OR_EQUAL_EXPRESSION:
+        return derived().visit_less_or_equal_expression(
+            static_cast<LessOrEqualExpressionData const&>(node));
+      case NodeKind::GREATER_OR_EQUAL_EXPRESSION:
+        return derived().visit_greater_or_equal_expression(
+            static_cast<GreaterOrEqualExpressionData const&>(node));
+      case NodeKind::ADD_EXPRESSION:
+        return derived().visit_add_expression(
+            static_cast<AddExpressionData const&>(node));
+      case NodeKind::SUBTRACT_EXPRESSION:
+        return derived().visit_subtract_expression(
+            static_cast<SubtractExpressionData const&>(node));
+      case NodeKind::MULTIPLY_EXPRESSION:
+        return derived().visit_multiply_expression(
+            static_cast<MultiplyExpressionData const&>(node));
+      case NodeKind::DIVIDE_EXPRESSION:
+        return derived().visit_divide_expression(
+            static_cast<DivideExpressionData const&>(node));
+      case NodeKind::MODULO_EXPRESSION:
+        return derived().visit_modulo_expression(
+            static_cast<ModuloExpressionData const&>(node));
+      case NodeKind::NOT_EXPRESSION:
+        return derived().visit_not_expression(
+            static_cast<NotExpressionData const&>(node));
+      case NodeKind::MINUS_EXPRESSION:
+        return derived().visit_minus_expression(
+            static_cast<MinusExpressionData const&>(node));
+      case NodeKind::FUNCTION_CALL_EXPRESSION:
+        return derived().visit_function_call_expression(
+            static_cast<FunctionCallExpressionData const&>(node));
+      case NodeKind::PARAMETER_LIST:
+        return derived().visit_parameter_list(
+            static_cast<ParameterListData const&>(node));
+      case NodeKind::PARAMETER:
+        return derived().visit_parameter(
+            static_cast<ParameterData const&>(node));
+      case NodeKind::PARENTHESIZED_EXPRESSION:
+        return derived().visit_parenthesized_expression(
+            static_cast<ParenthesizedExpressionData const&>(node));
+      case NodeKind::IDENTIFIER_EXPRESSION:
+        return derived().visit_identifier_expression(
+            static_cast<IdentifierExpressionData const&>(node));
+      case NodeKind::INTEGER_LITERAL_EXPRESSION:
+        return derived().visit_integer_literal_expression(
+            static_cast<IntegerLiteralExpressionData const&>(node));
+      case NodeKind::CHARACTER_LITERAL_EXPRESSION:
+        return derived().visit_character_literal_expression(
+            static_cast<CharacterLiteralExpressionData const&>(node));
+      case NodeKind::STRING_LITERAL_EXPRESSION:
+        return derived().visit_string_literal_expression(
+            static_cast<StringLiteralExpressionData const&>(node));
+    }
+  }
+
+  void visit_identifier(IdentifierData const&) {}
+
+  void visit_type(TypeData const&) {}
+
+  void visit_integer_literal(IntegerLiteralData const&) {}
+
+  void visit_character_literal(CharacterLiteralData const&) {}
+
+  void visit_string_literal(StringLiteralData const&) {}
+
+  void visit_translation_unit(TranslationUnitData const& node) {
+    children(node.functions());
+  }
+
+  void visit_function_definition(FunctionDefinitionData const& node) {
+    child(node.name());
+    child(node.arguments());
+    child(node.return_type());
+    child(node.body());
+  }
+
+  void visit_argument_list(ArgumentListData const& node) {
+    children(node.arguments());
+  }
+
+  void visit_argument(ArgumentData const& node) {
+    child(node.type());
+    child(node.name());
+  }
+
+  void visit_compound_statement(CompoundStatementData const& node) {
+    children(node.statements());
+  }
+
+  void visit_if_statement(IfStatementData const& node) {
+    child(node.condition());
+    child(node.body());
+    child(node.else_block());
+  }
+
+  void visit_else_statement(ElseStatementData const& node) {
+    child(node.body());
+  }
+
+  void visit_while_statement(WhileStatementData const& node) {
+    child(node.condition());
+    child(node.body());
+  }
+
+  void visit_for_statement(ForStatementData const& node) {
+    child(node.initialize());
+    child(node.condition());
+    child(node.reinitialize());
+    child(node.body());
+  }
+
+  void visit_return_statement(ReturnStatementData const& node) {
+    child(node.return_value());
+  }
+
+  void visit_break_statement(BreakStatementData const&) {}
+
+  void visit_continue_statement(ContinueStatementData const&) {}
+
+  void visit_variable_definition_statement(
+      VariableDefinitionStatementData const& node) {
+    child(node.variable_definition());
+  }
+
+  void visit_variable_definition(VariableDefinitionData const& node) {
+    child(node.type_name());
+    child(node.variable_name());
+    child(node.expression());
+  }
+
+  void visit_expression_statement(ExpressionStatementData const& node) {
+    child(node.body());
+  }
+
+  void visit_assign_expression(AssignExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_add_assign_expression(AddAssignExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_subtract_assign_expression(
+      SubtractAssignExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_multiply_assign_expression(
+      MultiplyAssignExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_divide_assign_expression(DivideAssignExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_modulo_assign_expression(ModuloAssignExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_or_expression(OrExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_and_expression(AndExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_equal_expression(EqualExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_not_equal_expression(NotEqualExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_less_expression(LessExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_greater_expression(GreaterExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_less_or_equal_expression(LessOrEqualExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_greater_or_equal_expression(
+      GreaterOrEqualExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_add_expression(AddExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_subtract_expression(SubtractExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_multiply_expression(MultiplyExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_divide_expression(DivideExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_modulo_expression(ModuloExpressionData const& node) {
+    child(node.lhs());
+    child(node.rhs());
+  }
+
+  void visit_not_expression(NotExpressionData const& node) {
+    child(node.expression());
+  }
+
+  void visit_minus_expression(MinusExpressionData const& node) {
+    child(node.expression());
+  }
+
+  void visit_function_call_expression(FunctionCallExpressionData const& node) {
+    child(node.function_name());
+    child(node.parameter_list());
+  }
+
+  void visit_parameter_list(ParameterListData const& node) {
+    children(node.parameters());
+  }
+
+  void visit_parameter(ParameterData const& node) {
+    child(node.expression());
+  }
+
+  void visit_parenthesized_expression(ParenthesizedExpressionData const& node) {
+    child(node.expression());
+  }
+
+  void visit_identifier_expression(IdentifierExpressionData const& node) {
+    child(node.expression());
+  }
+
+  void visit_integer_literal_expression(
+      IntegerLiteralExpressionData const& node) {
+    child(node.expression());
+  }
+
+  void visit_character_literal_expression(
+      CharacterLiteralExpressionData const& node) {
+    child(node.expression());
+  }
+
+  void visit_string_literal_expression(
+      StringLiteralExpressionData const& node) {
+    child(node.expression());
+  }
+
+ protected:
+  Derived& derived() { return static_cast<Derived&>(*this); }
+
+  // 省略できる子は空のことがある。
+  template <typename T>
+  void child(NodePtr<T> const& node) {
+    if (node) derived().visit(*node);
+  }
+
+  template <typename Range>
+  void children(Range const& nodes) {
+    for (auto const& node : nodes) child(node);
+  }
+};
+
+}  // namespace ast
+}  // namespace klang
+
+#endif  // KMC_KLANG_AST_VISITOR_HPP
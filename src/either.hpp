@@ -28,14 +28,14 @@ class Either;
 template <typename L>
 class Left {
  public:
-  explicit Left(const L& src)
+  constexpr explicit Left(const L& src)
       : left_{src}
   {}
-  explicit Left(L&& src)
+  constexpr explicit Left(L&& src)
       : left_{std::move(src)}
   {}
   template <typename... Args>
-  explicit Left(Args&&... args)
+  constexpr explicit Left(Args&&... args)
       : left_{std::forward<Args>(args)...}
   {}
   Left(const Left&) = default;
@@ -46,14 +46,14 @@ class Left {
     using std::swap;
     swap(left_, that.left_);
   }
-  const L& value() const& {
+  constexpr const L& value() const& {
     return left_;
   }
   L&& value() && {
     return std::move(left_);
   }
   template <typename R>
-  operator Either<L, R>() const& {
+  constexpr operator Either<L, R>() const& {
     return Either<L, R>{left_tag, left_};
   }
   template <typename R>
@@ -78,14 +78,14 @@ class Left {
 template <typename R>
 class Right {
  public:
-  explicit Right(const R& src)
+  constexpr explicit Right(const R& src)
       : right_{src}
   {}
-  explicit Right(R&& src)
+  constexpr explicit Right(R&& src)
       : right_{std::move(src)}
   {}
   template <typename... Args>
-  explicit Right(Args&&... args)
+  constexpr explicit Right(Args&&... args)
       : right_{std::forward<Args>(args)...}
   {}
   Right(const Right&) = default;
@@ -96,7 +96,7 @@ class Right {
     using std::swap;
     swap(right_, that.right_);
   }
-  const R& value() const& {
+  constexpr const R& value() const& {
     return right_;
   }
   R&& value() && {
@@ -104,7 +104,7 @@ class Right {
   }
   template <typename L, typename R_,
             typename enable_if_convertible<R, R_>::type*& = enabler>
-  operator Either<L, R_>() const& {
+  constexpr operator Either<L, R_>() const& {
     return Either<L, R_>{right_tag, right_};
   }
   template <typename L, typename R_,
@@ -127,57 +127,232 @@ class Right {
   R right_;
 };
 
-template <typename L, typename R>
-class Either {
- public:
-  Either(LeftTag, const L& left)
-      : is_right_{false}, left_{left}
+namespace detail {
+
+template <typename T, typename U>
+struct both_trivially_destructible
+    : std::integral_constant<bool,
+          std::is_trivially_destructible<T>::value &&
+          std::is_trivially_destructible<U>::value>
+{};
+
+template <typename T, typename U>
+struct both_trivially_copyable
+    : std::integral_constant<bool,
+          std::is_trivially_copyable<T>::value &&
+          std::is_trivially_copyable<U>::value>
+{};
+
+// 左右どちらかを、別に確保せずその場に置く。両方とも自明に破棄できれば
+// デストラクタを持たず、constexpr で作れる。
+template <typename L, typename R,
+          bool = both_trivially_destructible<L, R>::value>
+struct EitherStorage {
+  // 共用体を初期化しない。作った側が construct で左右どちらかを置く。
+  explicit EitherStorage(bool is_right)
+      : is_right_{is_right}
   {}
-  Either(LeftTag, L&& left)
-      : is_right_{false}, left_{std::move(left)}
+  template <typename... Args>
+  constexpr explicit EitherStorage(LeftTag, Args&&... args)
+      : is_right_{false}, left_{std::forward<Args>(args)...}
   {}
-  Either(RightTag, const R& right)
-      : is_right_{true}, right_{right}
+  template <typename... Args>
+  constexpr explicit EitherStorage(RightTag, Args&&... args)
+      : is_right_{true}, right_{std::forward<Args>(args)...}
   {}
-  Either(RightTag, R&& right)
-      : is_right_{true}, right_{std::move(right)}
+  void destruct() {}
+  bool is_right_;
+  union {
+    L left_;
+    R right_;
+  };
+};
+
+template <typename L, typename R>
+struct EitherStorage<L, R, false> {
+  explicit EitherStorage(bool is_right)
+      : is_right_{is_right}
   {}
   template <typename... Args>
-  explicit Either(LeftTag, Args&&... args)
+  explicit EitherStorage(LeftTag, Args&&... args)
       : is_right_{false}, left_{std::forward<Args>(args)...}
   {}
   template <typename... Args>
-  explicit Either(RightTag, Args&&... args)
+  explicit EitherStorage(RightTag, Args&&... args)
       : is_right_{true}, right_{std::forward<Args>(args)...}
   {}
-  Either(const Either& that)
-      : is_right_{that.is_right_} {
+  ~EitherStorage() {
+    destruct();
+  }
+  void destruct() {
+    if (is_right_) {
+      right_.~R();
+    } else {
+      left_.~L();
+    }
+  }
+  bool is_right_;
+  union {
+    L left_;
+    R right_;
+  };
+};
+
+// 両方とも自明にコピーできれば、コピーとムーブも自明にして、レジスタで
+// 受け渡せるようにする。
+template <typename L, typename R,
+          bool = both_trivially_copyable<L, R>::value>
+struct EitherBase : EitherStorage<L, R> {
+  using EitherStorage<L, R>::EitherStorage;
+};
+
+template <typename L, typename R>
+struct EitherBase<L, R, false> : EitherStorage<L, R> {
+  using EitherStorage<L, R>::EitherStorage;
+  EitherBase(const EitherBase& that)
+      noexcept(std::is_nothrow_copy_constructible<L>::value &&
+               std::is_nothrow_copy_constructible<R>::value)
+      : EitherStorage<L, R>{that.is_right_} {
     construct(that);
   }
-  Either(Either&& that)
-      : is_right_{that.is_right_} {
+  EitherBase(EitherBase&& that)
+      noexcept(std::is_nothrow_move_constructible<L>::value &&
+               std::is_nothrow_move_constructible<R>::value)
+      : EitherStorage<L, R>{that.is_right_} {
     construct(std::move(that));
   }
-  Either& operator=(const Either& that) {
-    assign(that);
+  EitherBase& operator=(const EitherBase& that)
+      noexcept(std::is_nothrow_copy_constructible<L>::value &&
+               std::is_nothrow_copy_constructible<R>::value &&
+               std::is_nothrow_copy_assignable<L>::value &&
+               std::is_nothrow_copy_assignable<R>::value) {
+    if (this->is_right_ == that.is_right_) {
+      if (this->is_right_) {
+        this->right_ = that.right_;
+      } else {
+        this->left_ = that.left_;
+      }
+    } else {
+      this->destruct();
+      construct(that);
+      this->is_right_ = that.is_right_;
+    }
     return *this;
   }
-  Either& operator=(Either&& that) {
-    assign(std::move(that));
+  EitherBase& operator=(EitherBase&& that)
+      noexcept(std::is_nothrow_move_constructible<L>::value &&
+               std::is_nothrow_move_constructible<R>::value &&
+               std::is_nothrow_move_assignable<L>::value &&
+               std::is_nothrow_move_assignable<R>::value) {
+    if (this->is_right_ == that.is_right_) {
+      if (this->is_right_) {
+        this->right_ = std::move(that.right_);
+      } else {
+        this->left_ = std::move(that.left_);
+      }
+    } else {
+      this->destruct();
+      construct(std::move(that));
+      this->is_right_ = that.is_right_;
+    }
     return *this;
   }
-  ~Either() {
-    destruct();
+  void construct(const EitherBase& src) {
+    if (src.is_right_) {
+      new (&this->right_) R{src.right_};
+    } else {
+      new (&this->left_) L{src.left_};
+    }
+  }
+  void construct(EitherBase&& src) {
+    if (src.is_right_) {
+      new (&this->right_) R{std::move(src.right_)};
+    } else {
+      new (&this->left_) L{std::move(src.left_)};
+    }
+  }
+};
+
+// 左右のどちらかがコピーできなければ、Either のコピーを削除する。
+// EitherBase のコピーは定義されているので、ここで決める。
+template <bool Copyable>
+struct EitherCopy {};
+
+template <>
+struct EitherCopy<false> {
+  EitherCopy() = default;
+  EitherCopy(const EitherCopy&) = delete;
+  EitherCopy(EitherCopy&&) = default;
+  EitherCopy& operator=(const EitherCopy&) = delete;
+  EitherCopy& operator=(EitherCopy&&) = default;
+};
+
+template <typename L, typename R>
+struct both_copyable
+    : std::integral_constant<bool,
+          std::is_copy_constructible<L>::value &&
+          std::is_copy_constructible<R>::value &&
+          std::is_copy_assignable<L>::value &&
+          std::is_copy_assignable<R>::value>
+{};
+
+}  // namespace detail
+
+template <typename L, typename R>
+class Either
+    : private detail::EitherBase<L, R>,
+      private detail::EitherCopy<detail::both_copyable<L, R>::value> {
+  using Base = detail::EitherBase<L, R>;
+  using Base::is_right_;
+  using Base::left_;
+  using Base::right_;
+ public:
+  constexpr Either(LeftTag, const L& left)
+      : Base{left_tag, left}
+  {}
+  constexpr Either(LeftTag, L&& left)
+      : Base{left_tag, std::move(left)}
+  {}
+  constexpr Either(RightTag, const R& right)
+      : Base{right_tag, right}
+  {}
+  constexpr Either(RightTag, R&& right)
+      : Base{right_tag, std::move(right)}
+  {}
+  template <typename... Args>
+  constexpr explicit Either(LeftTag, Args&&... args)
+      : Base{left_tag, std::forward<Args>(args)...}
+  {}
+  template <typename... Args>
+  constexpr explicit Either(RightTag, Args&&... args)
+      : Base{right_tag, std::forward<Args>(args)...}
+  {}
+  Either(const Either&) = default;
+  Either(Either&&) = default;
+  // 左右それぞれが変換できる Either から作る。
+  template <typename L_, typename R_,
+            typename std::enable_if<
+                std::is_convertible<L_, L>::value &&
+                std::is_convertible<R_, R>::value>::type*& = enabler>
+  Either(Either<L_, R_>&& that)
+      : Base{that.is_right_} {
+    if (is_right_) {
+      new (&right_) R(std::move(that.right_));
+    } else {
+      new (&left_) L(std::move(that.left_));
+    }
   }
+  Either& operator=(const Either&) = default;
+  Either& operator=(Either&&) = default;
   void swap(Either& that) {
     Either tmp{std::move(*this)};
     *this = std::move(that);
     that = std::move(tmp);
   }
-  bool is_left() const {
+  constexpr bool is_left() const {
     return !is_right_;
   }
-  bool is_right() const {
+  constexpr bool is_right() const {
     return is_right_;
   }
   Left<L> left() const& {
@@ -198,22 +373,21 @@ class Either {
   }
   template <typename... Args>
   void emplace(LeftTag, Args&&... args) {
-    destruct();
+    this->destruct();
     is_right_ = false;
     new (&left_) L{std::forward<Args>(args)...};
   }
   template <typename... Args>
   void emplace(RightTag, Args&&... args) {
-    destruct();
+    this->destruct();
     is_right_ = true;
     new (&right_) R{std::forward<Args>(args)...};
   }
-  explicit operator bool() const {
+  constexpr explicit operator bool() const {
     return is_right_;
   }
-  const R& operator*() const& {
-    assert(is_right_);
-    return right_;
+  constexpr const R& operator*() const& {
+    return assert(is_right_), right_;
   }
   R& operator*() & {
     assert(is_right_);
@@ -231,6 +405,56 @@ class Either {
     assert(is_right_);
     return &right_;
   }
+  // 右なら値を、左なら other を返す。
+  template <typename U>
+  constexpr R value_or(U&& other) const& {
+    return is_right_ ? right_ : static_cast<R>(std::forward<U>(other));
+  }
+  template <typename U>
+  R value_or(U&& other) && {
+    return is_right_ ? std::move(right_)
+                     : static_cast<R>(std::forward<U>(other));
+  }
+  // 右なら値に f を適用した結果を右に持つ Either を返す。左はそのまま。
+  template <typename F>
+  auto map(F&& f) const&
+      -> Either<L, typename std::decay<decltype(f(std::declval<const R&>()))>::type> {
+    using Result =
+        Either<L, typename std::decay<decltype(f(std::declval<const R&>()))>::type>;
+    return is_right_ ? Result{right_tag, f(right_)} : Result{left_tag, left_};
+  }
+  template <typename F>
+  auto map(F&& f) &&
+      -> Either<L, typename std::decay<decltype(f(std::declval<R&&>()))>::type> {
+    using Result =
+        Either<L, typename std::decay<decltype(f(std::declval<R&&>()))>::type>;
+    return is_right_ ? Result{right_tag, f(std::move(right_))}
+                     : Result{left_tag, std::move(left_)};
+  }
+  // 右なら値に Either を返す f を適用する。左はそのまま。
+  template <typename F>
+  auto and_then(F&& f) const& -> decltype(f(std::declval<const R&>())) {
+    using Result = decltype(f(std::declval<const R&>()));
+    return is_right_ ? f(right_) : Result{left_tag, left_};
+  }
+  template <typename F>
+  auto and_then(F&& f) && -> decltype(f(std::declval<R&&>())) {
+    using Result = decltype(f(std::declval<R&&>()));
+    return is_right_ ? f(std::move(right_))
+                     : Result{left_tag, std::move(left_)};
+  }
+  // 左なら値に Either を返す f を適用する。右はそのまま。
+  template <typename F>
+  auto or_else(F&& f) const& -> decltype(f(std::declval<const L&>())) {
+    using Result = decltype(f(std::declval<const L&>()));
+    return is_right_ ? Result{right_tag, right_} : f(left_);
+  }
+  template <typename F>
+  auto or_else(F&& f) && -> decltype(f(std::declval<L&&>())) {
+    using Result = decltype(f(std::declval<L&&>()));
+    return is_right_ ? Result{right_tag, std::move(right_)}
+                     : f(std::move(left_));
+  }
   template <typename L_, typename R_>
   friend class Either;
   friend void swap(Either& lhs, Either& rhs) {
@@ -254,79 +478,25 @@ class Either {
       return lhs.left_ < rhs.left_;
     }
   }
- private:
-  void construct(const Either& src) {
-    if (src.is_right_) {
-      new (&right_) R{src.right_};
-    } else {
-      new (&left_) L{src.left_};
-    }
-  }
-  void construct(Either&& src) {
-    if (src.is_right_) {
-      new (&right_) R{std::move(src.right_)};
-    } else {
-      new (&left_) L{std::move(src.left_)};
-    }
-  }
-  void assign(const Either& src) {
-    if (is_right_ == src.is_right_) {
-      if (is_right_) {
-        right_ = src.right_;
-      } else {
-        left_ = src.left_;
-      }
-    } else {
-      destruct();
-      construct(src);
-      is_right_ = src.is_right_;
-    }
-  }
-  void assign(Either&& src) {
-    if (is_right_ == src.is_right_) {
-      if (is_right_) {
-        right_ = std::move(src.right_);
-      } else {
-        left_ = std::move(src.left_);
-      }
-    } else {
-      destruct();
-      construct(std::move(src));
-      is_right_ = src.is_right_;
-    }
-  }
-  void destruct() {
-    if (is_right_) {
-      right_.~R();
-    } else {
-      left_.~L();
-    }
-  }
- private:
-  bool is_right_;
-  union {
-    L left_;
-    R right_;
-  };
 };
 
 template <typename T>
-Left<typename std::decay<T>::type> make_left(T&& left) {
+constexpr Left<typename std::decay<T>::type> make_left(T&& left) {
   return Left<typename std::decay<T>::type>{std::forward<T>(left)};
 }
 
 template <typename T, typename... Args>
-Left<T> make_left(Args&&... args) {
+constexpr Left<T> make_left(Args&&... args) {
   return Left<T>{std::forward<Args>(args)...};
 }
 
 template <typename T>
-Right<typename std::decay<T>::type> make_right(T&& right) {
+constexpr Right<typename std::decay<T>::type> make_right(T&& right) {
   return Right<typename std::decay<T>::type>{std::forward<T>(right)};
 }
 
 template <typename T, typename... Args>
-Right<T> make_right(Args&&... args) {
+constexpr Right<T> make_right(Args&&... args) {
   return Right<T>{std::forward<Args>(args)...};
 }
 
@@ -0,0 +1,382 @@
+#include "flat_ast.hpp"
+
+#include "ast_data.hpp"
+
+#include <unordered_map>
+
+namespace klang {
+namespace flat {
+
+StringTable::StringTable()
+    : chars_{},
+      offsets_(1, 0)
+{}
+
+std::uint32_t StringTable::add(StringRef str) {
+  chars_.append(str.data(), str.size());
+  offsets_.push_back(static_cast<std::uint32_t>(chars_.size()));
+  return static_cast<std::uint32_t>(offsets_.size() - 2);
+}
+
+std::size_t StringTable::memory_usage() const {
+  return chars_.capacity() + offsets_.capacity() * sizeof(std::uint32_t);
+}
+
+std::size_t Tree::child_count(Index i) const {
+  std::size_t count = 0;
+  for (Index c = first_child(i), e = end(i); c != e; c = next_sibling(c)) {
+    ++count;
+  }
+  return count;
+}
+
+auto Tree::child(Index i, std::size_t n) const -> Index {
+  Index c = first_child(i);
+  while (n--) c = next_sibling(c);
+  return c;
+}
+
+StringRef Tree::str(Index i) const {
+  switch (kind(i)) {
+    case NodeKind::IDENTIFIER:
+    case NodeKind::TYPE:
+      return names_[nodes_[i].value];
+    case NodeKind::INTEGER_LITERAL:
+    case NodeKind::CHARACTER_LITERAL:
+    case NodeKind::STRING_LITERAL:
+      return literals_[nodes_[i].value];
+    default:
+      return StringRef();
+  }
+}
+
+std::size_t Tree::memory_usage() const {
+  return nodes_.capacity() * sizeof(Node) +
+      names_.memory_usage() + literals_.memory_usage();
+}
+
+bool operator==(Tree const& lhs, Tree const& rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (Tree::Index i = 0; i < lhs.size(); ++i) {
+    if (lhs.kind(i) != rhs.kind(i) ||
+        lhs[i].is_mutable != rhs[i].is_mutable ||
+        lhs.end(i) != rhs.end(i) ||
+        lhs.str(i) != rhs.str(i)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool operator!=(Tree const& lhs, Tree const& rhs) {
+  return !(lhs == rhs);
+}
+
+class Builder {
+ public:
+  Tree build(ast::TranslationUnit const& unit);
+ private:
+  using Index = Tree::Index;
+  Index open(NodeKind kind);
+  void close(Index i);
+  void leaf(NodeKind kind, std::uint32_t value = 0);
+  void name(NodeKind kind, ast::Base const* node);
+  void literal(NodeKind kind, StringRef value);
+  void function_definition(ast::FunctionDefinition const& node);
+  void statement(ast::Statement const* node);
+  void expression(ast::Expression const* node);
+  template <typename T>
+  void binary(ast::Expression const& node, NodeKind kind);
+  Tree tree_;
+  // 名前は Interner の番号で引く。
+  std::unordered_map<Interner::Id, std::uint32_t> names_;
+  // キーは構文木の文字列を指すので、変換の間だけ有効。
+  std::unordered_map<StringRef, std::uint32_t, StringRefHash> literals_;
+};
+
+Tree Builder::build(ast::TranslationUnit const& unit) {
+  auto const& data = static_cast<ast::TranslationUnitData const&>(unit);
+  const auto root = open(NodeKind::TRANSLATION_UNIT);
+  for (auto const& function : data.functions()) {
+    function_definition(*function);
+  }
+  close(root);
+  tree_.nodes_.shrink_to_fit();
+  return std::move(tree_);
+}
+
+auto Builder::open(NodeKind kind) -> Index {
+  tree_.nodes_.push_back(Node{kind, false, 0});
+  return static_cast<Index>(tree_.nodes_.size() - 1);
+}
+
+void Builder::close(Index i) {
+  tree_.nodes_[i].value = static_cast<std::uint32_t>(tree_.nodes_.size());
+}
+
+void Builder::leaf(NodeKind kind, std::uint32_t value) {
+  tree_.nodes_.push_back(Node{kind, false, value});
+}
+
+void Builder::name(NodeKind kind, ast::Base const* node) {
+  Interner::Id id = 0;
+  if (node && node->kind() == ast::NodeKind::IDENTIFIER) {
+    id = static_cast<ast::IdentifierData const*>(node)->id();
+  } else if (node && node->kind() == ast::NodeKind::TYPE) {
+    id = static_cast<ast::TypeData const*>(node)->id();
+  }
+  auto it = names_.emplace(id, names_.size()).first;
+  if (it->second == tree_.names_.size()) {
+    tree_.names_.add(Interner::global().str(id));
+  }
+  leaf(kind, it->second);
+}
+
+void Builder::literal(NodeKind kind, StringRef value) {
+  auto it = literals_.emplace(value, literals_.size()).first;
+  if (it->second == tree_.literals_.size()) {
+    tree_.literals_.add(value);
+  }
+  leaf(kind, it->second);
+}
+
+// 各ノードの型は kind() で決まるので、ast::Visitor と同じく static_cast で
+// 下ろす。種類が 1 つしかない子はそのまま下ろす。
+void Builder::function_definition(ast::FunctionDefinition const& node) {
+  auto const& data = static_cast<ast::FunctionDefinitionData const&>(node);
+  const auto i = open(NodeKind::FUNCTION_DEFINITION);
+  name(NodeKind::IDENTIFIER, data.name().get());
+  const auto arguments = open(NodeKind::ARGUMENT_LIST);
+  auto const& argument_list =
+      static_cast<ast::ArgumentListData const&>(*data.arguments());
+  for (auto const& argument : argument_list.arguments()) {
+    auto const& argument_data =
+        static_cast<ast::ArgumentData const&>(*argument);
+    const auto a = open(NodeKind::ARGUMENT);
+    name(NodeKind::TYPE, argument_data.type().get());
+    name(NodeKind::IDENTIFIER, argument_data.name().get());
+    close(a);
+  }
+  close(arguments);
+  name(NodeKind::TYPE, data.return_type().get());
+  statement(data.body().get());
+  close(i);
+}
+
+void Builder::statement(ast::Statement const* node) {
+  using namespace ast;
+  if (node == nullptr) return;
+  switch (node->kind()) {
+    case ast::NodeKind::COMPOUND_STATEMENT: {
+      auto const& compound = static_cast<CompoundStatementData const&>(*node);
+      const auto i = open(NodeKind::COMPOUND_STATEMENT);
+      for (auto const& child : compound.statements()) {
+        statement(child.get());
+      }
+      close(i);
+      break;
+    }
+    case ast::NodeKind::IF_STATEMENT: {
+      auto const& if_ = static_cast<IfStatementData const&>(*node);
+      const auto i = open(NodeKind::IF_STATEMENT);
+      expression(if_.condition().get());
+      statement(if_.body().get());
+      if (if_.else_block()) {
+        statement(if_.else_block().get());
+      }
+      close(i);
+      break;
+    }
+    case ast::NodeKind::ELSE_STATEMENT: {
+      auto const& else_ = static_cast<ElseStatementData const&>(*node);
+      const auto i = open(NodeKind::ELSE_STATEMENT);
+      statement(else_.body().get());
+      close(i);
+      break;
+    }
+    case ast::NodeKind::WHILE_STATEMENT: {
+      auto const& while_ = static_cast<WhileStatementData const&>(*node);
+      const auto i = open(NodeKind::WHILE_STATEMENT);
+      expression(while_.condition().get());
+      statement(while_.body().get());
+      close(i);
+      break;
+    }
+    case ast::NodeKind::FOR_STATEMENT: {
+      auto const& for_ = static_cast<ForStatementData const&>(*node);
+      const auto i = open(NodeKind::FOR_STATEMENT);
+      expression(for_.initialize().get());
+      expression(for_.condition().get());
+      expression(for_.reinitialize().get());
+      statement(for_.body().get());
+      close(i);
+      break;
+    }
+    case ast::NodeKind::RETURN_STATEMENT: {
+      auto const& return_ = static_cast<ReturnStatementData const&>(*node);
+      const auto i = open(NodeKind::RETURN_STATEMENT);
+      expression(return_.return_value().get());
+      close(i);
+      break;
+    }
+    case ast::NodeKind::BREAK_STATEMENT:
+      leaf(NodeKind::BREAK_STATEMENT);
+      break;
+    case ast::NodeKind::CONTINUE_STATEMENT:
+      leaf(NodeKind::CONTINUE_STATEMENT);
+      break;
+    case ast::NodeKind::VARIABLE_DEFINITION_STATEMENT: {
+      auto const& definition = static_cast<VariableDefinitionData const&>(
+          *static_cast<VariableDefinitionStatementData const&>(*node)
+              .variable_definition());
+      const auto i = open(NodeKind::VARIABLE_DEFINITION);
+      tree_.nodes_[i].is_mutable = definition.is_mutable();
+      name(NodeKind::TYPE, definition.type_name().get());
+      name(NodeKind::IDENTIFIER, definition.variable_name().get());
+      expression(definition.expression().get());
+      close(i);
+      break;
+    }
+    case ast::NodeKind::EXPRESSION_STATEMENT: {
+      const auto i = open(NodeKind::EXPRESSION_STATEMENT);
+      expression(
+          static_cast<ExpressionStatementData const&>(*node).body().get());
+      close(i);
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+template <typename T>
+void Builder::binary(ast::Expression const& node, NodeKind kind) {
+  auto const& data = static_cast<T const&>(node);
+  const auto i = open(kind);
+  expression(data.lhs().get());
+  expression(data.rhs().get());
+  close(i);
+}
+
+void Builder::expression(ast::Expression const* node) {
+  using namespace ast;
+  if (node == nullptr) {
+    leaf(NodeKind::EMPTY);
+    return;
+  }
+  switch (node->kind()) {
+    case ast::NodeKind::IDENTIFIER_EXPRESSION:
+      name(NodeKind::IDENTIFIER,
+           static_cast<IdentifierExpressionData const&>(*node)
+               .expression().get());
+      break;
+    case ast::NodeKind::INTEGER_LITERAL_EXPRESSION:
+      literal(NodeKind::INTEGER_LITERAL,
+              static_cast<IntegerLiteralData const&>(
+                  *static_cast<IntegerLiteralExpressionData const&>(*node)
+                      .expression()).value());
+      break;
+    case ast::NodeKind::CHARACTER_LITERAL_EXPRESSION:
+      literal(NodeKind::CHARACTER_LITERAL,
+              static_cast<CharacterLiteralData const&>(
+                  *static_cast<CharacterLiteralExpressionData const&>(*node)
+                      .expression()).value());
+      break;
+    case ast::NodeKind::STRING_LITERAL_EXPRESSION:
+      literal(NodeKind::STRING_LITERAL,
+              static_cast<StringLiteralData const&>(
+                  *static_cast<StringLiteralExpressionData const&>(*node)
+                      .expression()).value());
+      break;
+    case ast::NodeKind::PARENTHESIZED_EXPRESSION: {
+      const auto i = open(NodeKind::PARENTHESIZED);
+      expression(static_cast<ParenthesizedExpressionData const&>(*node)
+                     .expression().get());
+      close(i);
+      break;
+    }
+    case ast::NodeKind::FUNCTION_CALL_EXPRESSION: {
+      // 引数は関数名の後ろに直接並べる。
+      auto const& call = static_cast<FunctionCallExpressionData const&>(*node);
+      const auto i = open(NodeKind::FUNCTION_CALL);
+      name(NodeKind::IDENTIFIER, call.function_name().get());
+      auto const& parameters =
+          static_cast<ParameterListData const&>(*call.parameter_list());
+      for (auto const& parameter : parameters.parameters()) {
+        expression(
+            static_cast<ParameterData const&>(*parameter).expression().get());
+      }
+      close(i);
+      break;
+    }
+    case ast::NodeKind::NOT_EXPRESSION: {
+      const auto i = open(NodeKind::NOT);
+      expression(
+          static_cast<NotExpressionData const&>(*node).expression().get());
+      close(i);
+      break;
+    }
+    case ast::NodeKind::MINUS_EXPRESSION: {
+      const auto i = open(NodeKind::MINUS);
+      expression(
+          static_cast<MinusExpressionData const&>(*node).expression().get());
+      close(i);
+      break;
+    }
+    case ast::NodeKind::ADD_EXPRESSION:
+      return binary<AddExpressionData>(*node, NodeKind::ADD);
+    case ast::NodeKind::SUBTRACT_EXPRESSION:
+      return binary<SubtractExpressionData>(*node, NodeKind::SUBTRACT);
+    case ast::NodeKind::MULTIPLY_EXPRESSION:
+      return binary<MultiplyExpressionData>(*node, NodeKind::MULTIPLY);
+    case ast::NodeKind::DIVIDE_EXPRESSION:
+      return binary<DivideExpressionData>(*node, NodeKind::DIVIDE);
+    case ast::NodeKind::MODULO_EXPRESSION:
+      return binary<ModuloExpressionData>(*node, NodeKind::MODULO);
+    case ast::NodeKind::EQUAL_EXPRESSION:
+      return binary<EqualExpressionData>(*node, NodeKind::EQUAL);
+    case ast::NodeKind::NOT_EQUAL_EXPRESSION:
+      return binary<NotEqualExpressionData>(*node, NodeKind::NOT_EQUAL);
+    case ast::NodeKind::LESS_EXPRESSION:
+      return binary<LessExpressionData>(*node, NodeKind::LESS);
+    case ast::NodeKind::GREATER_EXPRESSION:
+      return binary<GreaterExpressionData>(*node, NodeKind::GREATER);
+    case ast::NodeKind::LESS_OR_EQUAL_EXPRESSION:
+      return binary<LessOrEqualExpressionData>(*node,
+                                               NodeKind::LESS_OR_EQUAL);
+    case ast::NodeKind::GREATER_OR_EQUAL_EXPRESSION:
+      return binary<GreaterOrEqualExpressionData>(*node,
+                                                  NodeKind::GREATER_OR_EQUAL);
+    case ast::NodeKind::AND_EXPRESSION:
+      return binary<AndExpressionData>(*node, NodeKind::AND);
+    case ast::NodeKind::OR_EXPRESSION:
+      return binary<OrExpressionData>(*node, NodeKind::OR);
+    case ast::NodeKind::ASSIGN_EXPRESSION:
+      return binary<AssignExpressionData>(*node, NodeKind::ASSIGN);
+    case ast::NodeKind::ADD_ASSIGN_EXPRESSION:
+      return binary<AddAssignExpressionData>(*node, NodeKind::ADD_ASSIGN);
+    case ast::NodeKind::SUBTRACT_ASSIGN_EXPRESSION:
+      return binary<SubtractAssignExpressionData>(*node,
+                                                  NodeKind::SUBTRACT_ASSIGN);
+    case ast::NodeKind::MULTIPLY_ASSIGN_EXPRESSION:
+      return binary<MultiplyAssignExpressionData>(*node,
+                                                  NodeKind::MULTIPLY_ASSIGN);
+    case ast::NodeKind::DIVIDE_ASSIGN_EXPRESSION:
+      return binary<DivideAssignExpressionData>(*node,
+                                                NodeKind::DIVIDE_ASSIGN);
+    case ast::NodeKind::MODULO_ASSIGN_EXPRESSION:
+      return binary<ModuloAssignExpressionData>(*node,
+                                                NodeKind::MODULO_ASSIGN);
+    default:
+      break;
+  }
+}
+
+Tree flatten(ast::TranslationUnit const& unit) {
+  return Builder().build(unit);
+}
+
+}  // namespace flat
+}  // namespace klang
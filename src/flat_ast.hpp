@@ -0,0 +1,130 @@
+#ifndef KMC_KLANG_FLAT_AST_HPP
+#define KMC_KLANG_FLAT_AST_HPP
+
+#include "ast.hpp"
+#include "string_ref.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace klang {
+namespace flat {
+
+// 葉になる種類を先に並べる。
+enum class NodeKind : std::uint8_t {
+  EMPTY,  // 省略された式
+  IDENTIFIER,
+  TYPE,
+  INTEGER_LITERAL,
+  CHARACTER_LITERAL,
+  STRING_LITERAL,
+  BREAK_STATEMENT,
+  CONTINUE_STATEMENT,
+  TRANSLATION_UNIT,
+  FUNCTION_DEFINITION,
+  ARGUMENT_LIST,
+  ARGUMENT,
+  COMPOUND_STATEMENT,
+  IF_STATEMENT,
+  ELSE_STATEMENT,
+  WHILE_STATEMENT,
+  FOR_STATEMENT,
+  RETURN_STATEMENT,
+  VARIABLE_DEFINITION,
+  EXPRESSION_STATEMENT,
+  ASSIGN,
+  ADD_ASSIGN,
+  SUBTRACT_ASSIGN,
+  MULTIPLY_ASSIGN,
+  DIVIDE_ASSIGN,
+  MODULO_ASSIGN,
+  OR,
+  AND,
+  EQUAL,
+  NOT_EQUAL,
+  LESS,
+  GREATER,
+  LESS_OR_EQUAL,
+  GREATER_OR_EQUAL,
+  ADD,
+  SUBTRACT,
+  MULTIPLY,
+  DIVIDE,
+  MODULO,
+  NOT,
+  MINUS,
+  FUNCTION_CALL,
+  PARENTHESIZED
+};
+
+constexpr bool is_leaf(NodeKind kind) {
+  return kind <= NodeKind::CONTINUE_STATEMENT;
+}
+
+// ノードは前順に並べる。最初の子はすぐ後ろのノードで、
+// 次の兄弟は部分木の終わりのノード。
+struct Node {
+  NodeKind kind;
+  bool is_mutable;  // VARIABLE_DEFINITION のときだけ意味を持つ
+  // 葉なら文字列表の添字、そうでなければ部分木の終わりの添字。
+  std::uint32_t value;
+};
+
+static_assert(sizeof(Node) == 8, "flat::Node must stay compact");
+
+// 重複のない文字列の表。
+class StringTable {
+ public:
+  StringTable();
+  std::uint32_t add(StringRef str);
+  StringRef operator[](std::uint32_t index) const {
+    return StringRef(chars_.data() + offsets_[index],
+                     offsets_[index + 1] - offsets_[index]);
+  }
+  std::size_t size() const { return offsets_.size() - 1; }
+  std::size_t memory_usage() const;
+ private:
+  std::string chars_;
+  std::vector<std::uint32_t> offsets_;
+};
+
+// 構文木を一つの配列に詰めた表現。
+// IdentifierExpression のような、子を一つ包むだけのノードは畳んである。
+class Tree {
+ public:
+  using Index = std::uint32_t;
+  Index root() const { return 0; }
+  std::size_t size() const { return nodes_.size(); }
+  Node const& operator[](Index i) const { return nodes_[i]; }
+  NodeKind kind(Index i) const { return nodes_[i].kind; }
+  Index first_child(Index i) const { return i + 1; }
+  Index end(Index i) const {
+    return is_leaf(nodes_[i].kind) ? i + 1 : nodes_[i].value;
+  }
+  Index next_sibling(Index i) const { return end(i); }
+  std::size_t child_count(Index i) const;
+  Index child(Index i, std::size_t n) const;
+  // IDENTIFIER と TYPE は名前の表、リテラルはリテラルの表を引く。
+  StringRef str(Index i) const;
+  StringTable const& names() const { return names_; }
+  StringTable const& literals() const { return literals_; }
+  std::size_t memory_usage() const;
+ private:
+  friend class Builder;
+  std::vector<Node> nodes_;
+  StringTable names_;
+  StringTable literals_;
+};
+
+// 形と文字列が同じなら等しい。
+bool operator==(Tree const& lhs, Tree const& rhs);
+bool operator!=(Tree const& lhs, Tree const& rhs);
+
+Tree flatten(ast::TranslationUnit const& unit);
+
+}  // namespace flat
+}  // namespace klang
+
+#endif  // KMC_KLANG_FLAT_AST_HPP
@@ -0,0 +1,125 @@
+#include "interner.hpp"
+
+#include <algorithm>
+
+namespace klang {
+
+namespace {
+
+// 番号を、それを含むブロックとブロック内の位置に分ける。
+struct Location {
+  int block;
+  std::size_t index;
+};
+
+Location locate(Interner::Id id, std::size_t first_block_size) {
+  // ブロック b の先頭は first_block_size * (2^b - 1)。
+  const std::uint64_t n = id / first_block_size + 1;
+  int block = 0;
+  while (n >> (block + 1)) ++block;
+  const std::uint64_t begin = first_block_size * ((std::uint64_t{1} << block) - 1);
+  return Location{block, static_cast<std::size_t>(id - begin)};
+}
+
+std::atomic<std::uint64_t> next_serial{1};
+
+// 同じ名前は続けて現れやすいので、ロックを取る前にスレッドごとの
+// 小さなキャッシュを引く。綴りは表が持つ写しを指す。
+struct CacheEntry {
+  std::uint64_t serial;
+  const char* data;
+  std::size_t size;
+  Interner::Id id;
+};
+
+constexpr std::size_t CACHE_SIZE = 512;
+thread_local CacheEntry cache[CACHE_SIZE];
+
+}  // unnamed namespace
+
+constexpr std::size_t Interner::SHARD_COUNT;
+constexpr std::size_t Interner::FIRST_BLOCK_SIZE;
+constexpr int Interner::BLOCK_COUNT;
+
+Interner::Interner()
+  : serial_(next_serial++),
+    size_(0)
+{
+  for (auto& block : blocks_) {
+    block.store(nullptr);
+  }
+}
+
+Interner::~Interner() {
+  for (auto& block : blocks_) {
+    delete[] block.load();
+  }
+}
+
+auto Interner::intern(StringRef str) -> Id {
+  const std::size_t hash = StringRefHash()(str);
+  CacheEntry& cached = cache[hash % CACHE_SIZE];
+  if (cached.serial == serial_ && cached.size == str.size() &&
+      std::equal(str.begin(), str.end(), cached.data)) {
+    return cached.id;
+  }
+  Shard& shard = shards_[(hash / CACHE_SIZE) % SHARD_COUNT];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const auto found = shard.ids.find(str);
+  Id id;
+  StringRef spelling;
+  if (found != shard.ids.end()) {
+    spelling = found->first;
+    id = found->second;
+  } else {
+    spelling = copy(shard, str);
+    id = size_++;
+    // 番号を表に載せる前に綴りを書いておく。番号を受け取ったスレッドは
+    // ロックかスレッドの合流を介するので、書き込みが見える。
+    *entry(id) = spelling;
+    shard.ids.emplace(spelling, id);
+  }
+  cached = CacheEntry{serial_, spelling.data(), spelling.size(), id};
+  return id;
+}
+
+StringRef Interner::str(Id id) const {
+  const Location location = locate(id, FIRST_BLOCK_SIZE);
+  return blocks_[location.block].load(std::memory_order_acquire)[
+      location.index];
+}
+
+StringRef Interner::copy(Shard& shard, StringRef str) {
+  if (static_cast<std::size_t>(shard.end - shard.current) < str.size()) {
+    const std::size_t size = std::max<std::size_t>(4096, str.size());
+    shard.chunks.emplace_back(new char[size]);
+    shard.current = shard.chunks.back().get();
+    shard.end = shard.current + size;
+  }
+  char* const p = shard.current;
+  std::copy(str.begin(), str.end(), p);
+  shard.current += str.size();
+  return StringRef(p, str.size());
+}
+
+StringRef* Interner::entry(Id id) {
+  const Location location = locate(id, FIRST_BLOCK_SIZE);
+  auto& block = blocks_[location.block];
+  StringRef* entries = block.load(std::memory_order_acquire);
+  if (!entries) {
+    std::lock_guard<std::mutex> lock(grow_mutex_);
+    entries = block.load(std::memory_order_relaxed);
+    if (!entries) {
+      entries = new StringRef[FIRST_BLOCK_SIZE << location.block];
+      block.store(entries, std::memory_order_release);
+    }
+  }
+  return entries + location.index;
+}
+
+Interner& Interner::global() {
+  static Interner interner;
+  return interner;
+}
+
+}  // namespace klang
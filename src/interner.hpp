@@ -0,0 +1,58 @@
+#ifndef KMC_KLANG_INTERNER_HPP
+#define KMC_KLANG_INTERNER_HPP
+
+#include "string_ref.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace klang {
+
+// 名前の綴りに 0 から順に番号を振る表。複数のスレッドから同時に使える。
+// 番号から綴りを引くのは O(1) で、ロックを取らない。
+class Interner {
+ public:
+  using Id = std::uint32_t;
+  Interner();
+  ~Interner();
+  Interner(const Interner&) = delete;
+  Interner& operator=(const Interner&) = delete;
+  // str と同じ綴りの番号を返す。初めての綴りなら写しを取って番号を振る。
+  Id intern(StringRef str);
+  // intern が返した番号の綴り。
+  StringRef str(Id id) const;
+  std::size_t size() const { return size_.load(); }
+  // 字句解析器と構文解析器が共有する表。
+  static Interner& global();
+ private:
+  // 綴りから番号への表は、ロックの競合を減らすために分けておく。
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_map<StringRef, Id, StringRefHash> ids;
+    std::vector<std::unique_ptr<char[]>> chunks;
+    char* current = nullptr;
+    char* end = nullptr;
+  };
+  static constexpr std::size_t SHARD_COUNT = 16;
+  // 番号から綴りへの表はブロックに分け、一度置いたブロックは動かさない。
+  // ブロック b は FIRST_BLOCK_SIZE << b 個の要素を持つ。
+  static constexpr std::size_t FIRST_BLOCK_SIZE = 1024;
+  static constexpr int BLOCK_COUNT = 23;
+  StringRef copy(Shard& shard, StringRef str);
+  StringRef* entry(Id id);
+  // スレッドごとの検索結果のキャッシュで、表を区別するための通し番号。
+  const std::uint64_t serial_;
+  Shard shards_[SHARD_COUNT];
+  std::atomic<StringRef*> blocks_[BLOCK_COUNT];
+  std::mutex grow_mutex_;
+  std::atomic<Id> size_;
+};
+
+}  // namespace klang
+
+#endif  // KMC_KLANG_INTERNER_HPP
@@ -1,213 +1,950 @@
 #include "lexer.hpp"
 
-#include <cctype>
+#include "scan.hpp"
+
+#include <cstring>
 #include <algorithm>
+#include <deque>
 #include <iterator>
+#include <thread>
+#include <unordered_map>
 
 namespace klang {
 namespace {
-  using const_iterator = std::string::const_iterator;
+  using const_iterator = const char*;
 }
 
 Token::Token()
-  : type_(TokenType::UNKNOWN), str_(), line_(-1)
+  : type_(TokenType::UNKNOWN), symbol_(SymbolKind::NONE),
+    offset_(0), length_(0), value_(0)
 {}
 
-Token::Token(TokenType type, const std::string& str, int line)
-  : type_(type), str_(str), line_(line)
+Token::Token(TokenType type, std::uint32_t offset, std::uint32_t length,
+             SymbolKind symbol, std::uint32_t value)
+  : type_(type), symbol_(symbol), offset_(offset), length_(length),
+    value_(value)
 {}
 
 TokenType Token::type() const { return type_; }
-std::string Token::str() const { return str_; }
-int Token::line() const { return line_; }
+SymbolKind Token::symbol() const { return symbol_; }
+std::uint32_t Token::offset() const { return offset_; }
+std::uint32_t Token::length() const { return length_; }
+Interner::Id Token::id() const { return value_; }
+std::uint32_t Token::literal() const { return value_; }
 
+constexpr std::uint32_t Token::RAW_LITERAL;
 
-bool alphabet(char c) {
-  return std::isalpha(c);
-}
+TokenVector::TokenVector()
+  : TokenVector(nullptr, std::string(), std::vector<Token>())
+{}
 
-bool alphabet_or_bar(char c) {
-  return (c == '_' || alphabet(c));
-}
+TokenVector::TokenVector(SourceBufferPtr source,
+                         std::string literals,
+                         std::vector<Token> tokens)
+  : data_(std::make_shared<Data>(
+        Data{std::move(source),
+             std::make_shared<const std::string>(std::move(literals)),
+             std::move(tokens)}))
+{}
 
-bool nonzero_digit(char c) {
-  return (c >= '1' && c <= '9');
+TokenVector::TokenVector(SourceBufferPtr source,
+                         TokenVector const& literals_from,
+                         std::vector<Token> tokens)
+  : data_(std::make_shared<Data>(
+        Data{std::move(source), literals_from.data_->literals,
+             std::move(tokens)}))
+{}
+
+namespace {
+
+StringRef literal_at(std::string const& literals, std::size_t position) {
+  std::uint32_t length;
+  std::memcpy(&length, literals.data() + position, sizeof(length));
+  return StringRef(literals.data() + position + sizeof(length), length);
 }
 
-bool decimal_digit(char c) {
-  return std::isdigit(c);
+// エスケープのない文字列リテラルの中身。引用符の内側を指す。
+StringRef raw_literal(const char* source, Token const& token) {
+  return StringRef(source + token.offset() + 1, token.length() - 2);
 }
 
-bool identifier(const_iterator head, const_iterator tail) {
-  if (head == tail || !alphabet_or_bar(*head)) {
-    return false;
+}  // unnamed namespace
+
+StringRef TokenVector::str(Token const& token) const {
+  if (token.decoded()) {
+    return literal_at(*data_->literals, token.literal());
   }
-  for (auto it(head); it != tail; ++it) {
-    if (!alphabet_or_bar(*it) && !decimal_digit(*it)) {
-      return false;
-    }
+  if (token.type() == TokenType::STRING) {
+    return raw_literal(data_->source->data(), token);
   }
-  return true;
+  return StringRef(data_->source->data() + token.offset(), token.length());
 }
 
-bool decimal_integer(const_iterator head, const_iterator tail) {
-  if (*head == '0' && std::distance(head, tail) == 1) return true;
-  if (head == tail || !nonzero_digit(*head)) {
-    return false;
-  }
-  for (auto it(head); it != tail; ++it) {
-    if (!decimal_digit(*it)) return false;
+std::uint32_t TokenVector::add_literal(std::string& literals, StringRef str) {
+  auto const position = static_cast<std::uint32_t>(literals.size());
+  auto const length = static_cast<std::uint32_t>(str.size());
+  literals.append(reinterpret_cast<const char*>(&length), sizeof(length));
+  literals.append(str.data(), str.size());
+  return position;
+}
+
+
+namespace {
+
+template <std::size_t N>
+bool equal_to(const char* str, const char (&literal)[N]) {
+  return std::equal(literal, literal + N - 1, str);
+}
+
+}  // unnamed namespace
+
+SymbolKind to_symbol_kind(StringRef str) {
+  // 長さと先頭の文字で分岐するので、一度に比べるのは高々 1 つの候補だけ。
+  const char* const s = str.data();
+  switch (str.size()) {
+    case 1:
+      switch (s[0]) {
+        case '~': return SymbolKind::TILDE;
+        case '+': return SymbolKind::PLUS;
+        case '-': return SymbolKind::MINUS;
+        case '*': return SymbolKind::ASTERISK;
+        case '/': return SymbolKind::SLASH;
+        case '%': return SymbolKind::PERCENT;
+        case '=': return SymbolKind::EQUAL;
+        case '<': return SymbolKind::LESS;
+        case '>': return SymbolKind::GREATER;
+        case ';': return SymbolKind::SEMICOLON;
+        case '(': return SymbolKind::LEFT_PAREN;
+        case ')': return SymbolKind::RIGHT_PAREN;
+        case '{': return SymbolKind::LEFT_BRACE;
+        case '}': return SymbolKind::RIGHT_BRACE;
+      }
+      break;
+    case 2:
+      switch (s[0]) {
+        case ':': if (s[1] == '=') return SymbolKind::ASSIGN; break;
+        case '=': if (s[1] == '/') return SymbolKind::NOT_EQUAL; break;
+        case '<': if (s[1] == '=') return SymbolKind::LESS_OR_EQUAL; break;
+        case '>': if (s[1] == '=') return SymbolKind::GREATER_OR_EQUAL; break;
+        case '-': if (s[1] == '>') return SymbolKind::ARROW; break;
+        case '~': if (s[1] == '}') return SymbolKind::CLOSE_COMMENT; break;
+        case 'o': if (s[1] == 'r') return SymbolKind::OR; break;
+        case 'i': if (s[1] == 'f') return SymbolKind::IF; break;
+      }
+      break;
+    case 3:
+      switch (s[0]) {
+        case ':':
+          if (s[2] != '=') break;
+          switch (s[1]) {
+            case '+': return SymbolKind::ADD_ASSIGN;
+            case '-': return SymbolKind::SUBTRACT_ASSIGN;
+            case '*': return SymbolKind::MULTIPLY_ASSIGN;
+            case '/': return SymbolKind::DIVIDE_ASSIGN;
+            case '%': return SymbolKind::MODULO_ASSIGN;
+          }
+          break;
+        case 'a': if (equal_to(s, "and")) return SymbolKind::AND; break;
+        case 'n': if (equal_to(s, "not")) return SymbolKind::NOT; break;
+        case 'i': if (equal_to(s, "int")) return SymbolKind::INT; break;
+        case 'd': if (equal_to(s, "def")) return SymbolKind::DEF; break;
+        case 'v': if (equal_to(s, "var")) return SymbolKind::VAR; break;
+        case 'f': if (equal_to(s, "for")) return SymbolKind::FOR; break;
+      }
+      break;
+    case 4:
+      if (equal_to(s, "else")) return SymbolKind::ELSE;
+      break;
+    case 5:
+      switch (s[0]) {
+        case 'w': if (equal_to(s, "while")) return SymbolKind::WHILE; break;
+        case 'b': if (equal_to(s, "break")) return SymbolKind::BREAK; break;
+      }
+      break;
+    case 6:
+      if (equal_to(s, "return")) return SymbolKind::RETURN;
+      break;
+    case 8:
+      if (equal_to(s, "continue")) return SymbolKind::CONTINUE;
+      break;
   }
-  return true;
+  return SymbolKind::NONE;
 }
 
-bool symbol(const_iterator head, const_iterator tail) {
-  using std::begin;
-  using std::end;
-  std::string const str(head, tail);
-  static std::vector<std::string> const symbol_list = {
+StringRef to_string(SymbolKind kind) {
+  static const char* const names[] = {
+    "",
     "~", "+", "-", "*", "/", "%",
     ":=", ":+=", ":-=", ":*=", ":/=", ":%=",
     "=", "=/", "<", ">", "<=", ">=",
     ";", "(", ")", "{", "}", "->", "~}",
     "and", "or", "not", "int", "def", "var",
-    "if", "else", "while", "for", "break", "continue", "return"
+    "if", "else", "while", "for", "break", "continue", "return",
+    ","
   };
-  return (std::find(begin(symbol_list), end(symbol_list), str) != end(symbol_list));
+  return names[static_cast<std::size_t>(kind)];
 }
 
-bool ignore(const_iterator head, const_iterator tail) {
-  if(std::distance(head, tail) != 1) return false;
-  // `std::distance(head, tail) != 1` は、`next(head) != tail` のほうが高速かもしれない。
-  // 意図が失われるので、ひとまず`distance` を使う。
-  return std::isspace(*head);
+namespace {
+
+// 文字の性質。<cctype> と違ってロケールに依らず、ASCII 以外はどれにも
+// 当たらない。
+enum CharFlag : std::uint8_t {
+  CF_IDENTIFIER_START = 1 << 0,  // 英字と '_'
+  CF_DIGIT            = 1 << 1,
+  CF_SPACE            = 1 << 2,  // std::isspace と同じ 6 文字
+  CF_OPERATOR         = 1 << 3,  // 記号の先頭になる文字
+  CF_QUOTE            = 1 << 4
+};
+
+constexpr bool in_range(unsigned c, char first, char last) {
+  return static_cast<unsigned>(first) <= c && c <= static_cast<unsigned>(last);
 }
 
-bool singleline_comment(const_iterator head, const_iterator tail) {
-  using std::begin;
-  using std::end;
-  if(std::distance(head, tail) < 2) return false; // コメントの長さは2 より長い(~~ を含む)
-  if(std::equal(head, std::next(head, 2), "~~")) {
-      return std::find(head, tail, '\n') != std::prev(tail);
-  }
-  return false;
+constexpr std::uint8_t char_flags(unsigned c) {
+  return (in_range(c, 'a', 'z') || in_range(c, 'A', 'Z') || c == '_') ?
+             CF_IDENTIFIER_START :
+         in_range(c, '0', '9') ? CF_DIGIT :
+         (c == ' ' || in_range(c, '\t', '\r')) ? CF_SPACE :
+         c == '"' ? CF_QUOTE :
+         (c == '~' || c == '+' || c == '-' || c == '*' || c == '/' ||
+          c == '%' || c == ':' || c == '=' || c == '<' || c == '>' ||
+          c == ';' || c == '(' || c == ')' || c == '{' || c == '}') ?
+             CF_OPERATOR :
+         0;
 }
 
-bool multiline_comment(const_iterator head, const_iterator tail) {
-  using std::begin;
-  using std::end;
-  if (std::equal(head, std::next(head, 2), "{~")) {
-    int nest = 0;
-    for(auto it = head; std::next(it) != tail; ++it) {
-      std::string tk(it, std::next(it, 2));
-      if (tk == "{~") {
-        ++nest;
-      } else if(tk == "~}") {
-        --nest;
+#define KLANG_CHAR_ROW(f, row)                                         \
+  f(row + 0x0), f(row + 0x1), f(row + 0x2), f(row + 0x3),              \
+  f(row + 0x4), f(row + 0x5), f(row + 0x6), f(row + 0x7),              \
+  f(row + 0x8), f(row + 0x9), f(row + 0xa), f(row + 0xb),              \
+  f(row + 0xc), f(row + 0xd), f(row + 0xe), f(row + 0xf)
+#define KLANG_CHAR_TABLE(f)                                            \
+  KLANG_CHAR_ROW(f, 0x00), KLANG_CHAR_ROW(f, 0x10),                    \
+  KLANG_CHAR_ROW(f, 0x20), KLANG_CHAR_ROW(f, 0x30),                    \
+  KLANG_CHAR_ROW(f, 0x40), KLANG_CHAR_ROW(f, 0x50),                    \
+  KLANG_CHAR_ROW(f, 0x60), KLANG_CHAR_ROW(f, 0x70),                    \
+  KLANG_CHAR_ROW(f, 0x80), KLANG_CHAR_ROW(f, 0x90),                    \
+  KLANG_CHAR_ROW(f, 0xa0), KLANG_CHAR_ROW(f, 0xb0),                    \
+  KLANG_CHAR_ROW(f, 0xc0), KLANG_CHAR_ROW(f, 0xd0),                    \
+  KLANG_CHAR_ROW(f, 0xe0), KLANG_CHAR_ROW(f, 0xf0)
+
+constexpr std::uint8_t CHAR_FLAGS[256] = { KLANG_CHAR_TABLE(char_flags) };
+
+constexpr bool has_flag(char c, CharFlag flag) {
+  return (CHAR_FLAGS[static_cast<unsigned char>(c)] & flag) != 0;
+}
+
+static_assert(has_flag('_', CF_IDENTIFIER_START) && has_flag('7', CF_DIGIT) &&
+              !has_flag('7', CF_IDENTIFIER_START) && has_flag('\v', CF_SPACE) &&
+              has_flag('~', CF_OPERATOR) && CHAR_FLAGS[0xe3] == 0,
+              "character flags");
+
+// 字句解析の DFA で使う文字の分類。
+enum CharClass : unsigned char {
+  CC_OTHER, CC_SPACE, CC_NEWLINE, CC_ALPHA, CC_ZERO, CC_DIGIT,
+  CC_TILDE, CC_LBRACE, CC_RBRACE, CC_COLON, CC_EQUAL, CC_SLASH,
+  CC_PLUS, CC_MINUS, CC_STAR, CC_PERCENT, CC_LESS, CC_GREATER,
+  CC_SEMICOLON, CC_LPAREN, CC_RPAREN, CC_QUOTE, CC_BACKSLASH,
+  CC_COUNT
+};
+
+constexpr CharClass classify_operator(unsigned c) {
+  return c == '~' ? CC_TILDE :
+         c == '{' ? CC_LBRACE :
+         c == '}' ? CC_RBRACE :
+         c == ':' ? CC_COLON :
+         c == '=' ? CC_EQUAL :
+         c == '/' ? CC_SLASH :
+         c == '+' ? CC_PLUS :
+         c == '-' ? CC_MINUS :
+         c == '*' ? CC_STAR :
+         c == '%' ? CC_PERCENT :
+         c == '<' ? CC_LESS :
+         c == '>' ? CC_GREATER :
+         c == ';' ? CC_SEMICOLON :
+         c == '(' ? CC_LPAREN :
+         CC_RPAREN;
+}
+
+constexpr CharClass classify(unsigned c) {
+  return (CHAR_FLAGS[c] & CF_OPERATOR)         ? classify_operator(c) :
+         (CHAR_FLAGS[c] & CF_IDENTIFIER_START) ? CC_ALPHA :
+         c == '0'                              ? CC_ZERO :
+         (CHAR_FLAGS[c] & CF_DIGIT)            ? CC_DIGIT :
+         c == '\n'                             ? CC_NEWLINE :
+         (CHAR_FLAGS[c] & CF_SPACE)            ? CC_SPACE :
+         (CHAR_FLAGS[c] & CF_QUOTE)            ? CC_QUOTE :
+         c == '\\'                             ? CC_BACKSLASH :
+         CC_OTHER;
+}
+
+constexpr CharClass CHAR_CLASSES[256] = { KLANG_CHAR_TABLE(classify) };
+
+#undef KLANG_CHAR_TABLE
+#undef KLANG_CHAR_ROW
+
+// DFA の状態。DEAD に遷移した時点でトークンが確定する。
+enum State : unsigned char {
+  S_DEAD,
+  S_START,
+  S_SPACE,          // 空白 1 文字
+  S_IDENTIFIER,     // 識別子かキーワード
+  S_ZERO,           // "0"
+  S_NUMBER,
+  S_SYMBOL,         // これ以上伸びない記号
+  S_TILDE,          // "~"
+  S_MINUS,          // "-"
+  S_EQUAL,          // "="
+  S_LESS,           // "<"
+  S_GREATER,        // ">"
+  S_LBRACE,         // "{"
+  S_COLON,          // ":"
+  S_COLON_OP,       // ":+" など
+  // ここから後ろは文字列とコメントの中の状態。
+  S_STRING,
+  S_STRING_ESCAPE,
+  S_STRING_END,
+  S_LINE_COMMENT,
+  S_COMMENT,        // {~ ~} の中
+  S_COMMENT_LBRACE, // {~ ~} の中で "{" の直後
+  S_COMMENT_TILDE,  // {~ ~} の中で "~" の直後
+  S_COMMENT_OPEN,   // "{~" の直後。入るたびにネストが深くなる
+  S_COMMENT_CLOSE,  // "~}" の直後。入るたびにネストが浅くなる
+  S_COMMENT_END,
+  S_COUNT
+};
+
+class Automaton {
+ public:
+  Automaton() {
+    for (auto& row : transition_) {
+      for (auto& next : row) next = S_DEAD;
+    }
+    for (auto& type : accept_) type = TokenType::UNKNOWN;
+
+    auto& start = transition_[S_START];
+    start[CC_SPACE] = start[CC_NEWLINE] = S_SPACE;
+    start[CC_ALPHA] = S_IDENTIFIER;
+    start[CC_ZERO] = S_ZERO;
+    start[CC_DIGIT] = S_NUMBER;
+    start[CC_TILDE] = S_TILDE;
+    start[CC_LBRACE] = S_LBRACE;
+    start[CC_COLON] = S_COLON;
+    start[CC_EQUAL] = S_EQUAL;
+    start[CC_MINUS] = S_MINUS;
+    start[CC_LESS] = S_LESS;
+    start[CC_GREATER] = S_GREATER;
+    start[CC_QUOTE] = S_STRING;
+    for (CharClass c : {CC_RBRACE, CC_SLASH, CC_PLUS, CC_STAR, CC_PERCENT,
+                        CC_SEMICOLON, CC_LPAREN, CC_RPAREN}) {
+      start[c] = S_SYMBOL;
+    }
+
+    for (CharClass c : {CC_ALPHA, CC_ZERO, CC_DIGIT}) {
+      transition_[S_IDENTIFIER][c] = S_IDENTIFIER;
+    }
+    transition_[S_NUMBER][CC_ZERO] = transition_[S_NUMBER][CC_DIGIT] = S_NUMBER;
+
+    transition_[S_TILDE][CC_TILDE] = S_LINE_COMMENT;
+    transition_[S_TILDE][CC_RBRACE] = S_SYMBOL;
+    transition_[S_MINUS][CC_GREATER] = S_SYMBOL;
+    transition_[S_EQUAL][CC_SLASH] = S_SYMBOL;
+    transition_[S_LESS][CC_EQUAL] = S_SYMBOL;
+    transition_[S_GREATER][CC_EQUAL] = S_SYMBOL;
+    transition_[S_LBRACE][CC_TILDE] = S_COMMENT_OPEN;
+    transition_[S_COLON][CC_EQUAL] = S_SYMBOL;
+    for (CharClass c : {CC_PLUS, CC_MINUS, CC_STAR, CC_SLASH, CC_PERCENT}) {
+      transition_[S_COLON][c] = S_COLON_OP;
+    }
+    transition_[S_COLON_OP][CC_EQUAL] = S_SYMBOL;
+
+    for (int c = 0; c < CC_COUNT; ++c) {
+      transition_[S_STRING][c] = S_STRING;
+      transition_[S_STRING_ESCAPE][c] = S_STRING;
+      transition_[S_LINE_COMMENT][c] = S_LINE_COMMENT;
+      // "{~}" のように、"{~" と "~}" は "~" を共有できる。
+      for (State s : {S_COMMENT, S_COMMENT_LBRACE, S_COMMENT_TILDE,
+                      S_COMMENT_OPEN, S_COMMENT_CLOSE}) {
+        transition_[s][c] = S_COMMENT;
       }
     }
-    bool closed = (nest == 0 &&
-                   std::equal(std::prev(tail, 2), std::prev(tail), "~}"));
-    return (nest > 0 || closed);
+    transition_[S_STRING][CC_QUOTE] = S_STRING_END;
+    transition_[S_STRING][CC_BACKSLASH] = S_STRING_ESCAPE;
+    transition_[S_LINE_COMMENT][CC_NEWLINE] = S_DEAD;
+    for (State s : {S_COMMENT, S_COMMENT_LBRACE, S_COMMENT_TILDE,
+                    S_COMMENT_OPEN, S_COMMENT_CLOSE}) {
+      transition_[s][CC_LBRACE] = S_COMMENT_LBRACE;
+      transition_[s][CC_TILDE] = S_COMMENT_TILDE;
+    }
+    transition_[S_COMMENT_LBRACE][CC_TILDE] = S_COMMENT_OPEN;
+    transition_[S_COMMENT_TILDE][CC_RBRACE] = S_COMMENT_CLOSE;
+    transition_[S_COMMENT_OPEN][CC_RBRACE] = S_COMMENT_CLOSE;
+
+    accept_[S_SPACE] = TokenType::IGNORE;
+    accept_[S_IDENTIFIER] = TokenType::IDENTIFIER;
+    accept_[S_ZERO] = accept_[S_NUMBER] = TokenType::NUMBER;
+    for (State s : {S_SYMBOL, S_TILDE, S_MINUS, S_EQUAL, S_LESS, S_GREATER,
+                    S_LBRACE}) {
+      accept_[s] = TokenType::SYMBOL;
+    }
+    accept_[S_STRING_END] = TokenType::STRING;
+    for (State s : {S_LINE_COMMENT, S_COMMENT, S_COMMENT_LBRACE,
+                    S_COMMENT_TILDE, S_COMMENT_OPEN, S_COMMENT_CLOSE,
+                    S_COMMENT_END}) {
+      accept_[s] = TokenType::IGNORE;
+    }
+  }
+  CharClass char_class(char c) const {
+    return CHAR_CLASSES[static_cast<unsigned char>(c)];
+  }
+  State next(State s, CharClass c) const {
+    return transition_[s][c];
+  }
+  TokenType accept(State s) const {
+    return accept_[s];
+  }
+ private:
+  State transition_[S_COUNT][CC_COUNT];
+  TokenType accept_[S_COUNT];
+};
+
+Automaton const& automaton() {
+  static Automaton const instance;
+  return instance;
+}
+
+}  // unnamed namespace
+
+namespace {
+
+char unescape(char c) {
+  switch (c) {
+    case 'a': return '\a';
+    case 'b': return '\b';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 't': return '\t';
+    case 'v': return '\v';
+    case '0': return '\0';
+    default:  return c;  // this should warn "unknown escape sequence"
+  }
+}
+
+}  // unnamed namespace
+
+// [head, tail) の文字列リテラルをデコードして out の末尾に追加する。
+// エスケープの間はまとめて写す。
+void extract_string(const_iterator head, const_iterator tail,
+                    std::string& out) {
+  scan::Scanner const& scanner = scan::scanner();
+  // 閉じる引用符の直前は、エスケープされていない文字。
+  const_iterator it(head + 1);
+  const_iterator const last(tail - 1);
+  while (it != last) {
+    const_iterator const escape = scanner.find(it, last, '\\');
+    out.append(it, escape);
+    if (escape == last) break;
+    out.push_back(unescape(escape[1]));
+    it = escape + 2;
   }
-  return false;
 }
 
-bool comment(const_iterator head, const_iterator tail) {
-  return (singleline_comment(head, tail) || multiline_comment(head, tail));
+std::tuple<bool, TokenVector> tokenize(std::istream& is) {
+  using istrbuf_itr = std::istreambuf_iterator<char>;
+  return tokenize(std::make_shared<SourceBuffer>(
+      std::string{istrbuf_itr(is), istrbuf_itr()}));
+}
+
+std::tuple<bool, TokenVector> tokenize(StringRef code) {
+  return tokenize(SourceBuffer::borrow(code));
+}
+
+std::tuple<bool, TokenVector> tokenize_file(const std::string& path) {
+  if (auto source = SourceBuffer::map_file(path)) {
+    return tokenize(std::move(source));
+  }
+  return std::make_tuple(false, TokenVector());
 }
 
-bool string_token(const_iterator head, const_iterator tail) {
+namespace {
+
+struct LexResult {
+  std::size_t end;  // 最後に切り出したトークンの終わり
+  bool failed;
+};
+
+// head から字句解析し、トークンの境界が limit 以上になったところで止める。
+// トークンは状態を持ち越さずに S_START から読むので、どの境界から始めても
+// 先頭から読んだときと同じトークン列になる。
+LexResult lex(StringRef code, std::size_t head_offset, std::size_t limit,
+              std::vector<Token>& tokens, std::string& literals) {
   using std::begin;
   using std::end;
-  if (*head == '"') {
+  Automaton const& dfa = automaton();
+  Interner& interner = Interner::global();
+  scan::Scanner const& scanner = scan::scanner();
+  // エスケープを含むリテラルは、同じ綴りなら一度だけデコードする。
+  std::unordered_map<StringRef, std::uint32_t, StringRefHash> decoded;
+  const_iterator head(begin(code) + head_offset);
+  const_iterator const stop(begin(code) + limit);
+  // 最長一致で 1 トークンずつ切り出す。各文字は高々 1 回しか遷移させないので O(n)。
+  while (head < stop) {
+    if (has_flag(*head, CF_SPACE)) {
+      // 空白は 1 文字ずつのトークンで、出力もしないのでまとめて飛ばす。
+      // 字下げのような短い並びは表で読み、長く続くときだけ SIMD を使う。
+      const_iterator const near = std::min(head + 8, stop);
+      do ++head; while (head < near && has_flag(*head, CF_SPACE));
+      if (head == near) head = scanner.skip_spaces(head, stop);
+      continue;
+    }
+    State state = S_START;
+    int nest = 0;
     bool escaped = false;
-    for(auto it = std::next(head); it != tail; ++it) {
-      if (*it == '\\' && (!escaped)) {
-        escaped = true;
-      } else if (*it == '"' && (!escaped)) {
-        return std::next(it) == tail;
-      } else {
-        escaped = false;
+    auto it(head);
+    for (; it != end(code); ++it) {
+      State next = dfa.next(state, dfa.char_class(*it));
+      if (next == S_DEAD) break;
+      if (next >= S_STRING) {
+        // 文字列とコメントの中では、遷移が変わる文字まで一気に進める。
+        switch (next) {
+          case S_STRING:
+            it = scanner.find_either(it + 1, end(code), '"', '\\') - 1;
+            break;
+          case S_STRING_ESCAPE:
+            escaped = true;
+            break;
+          case S_LINE_COMMENT:
+            it = scanner.find(it + 1, end(code), '\n') - 1;
+            break;
+          case S_COMMENT:
+            it = scanner.find_either(it + 1, end(code), '{', '~') - 1;
+            break;
+          case S_COMMENT_OPEN:
+            ++nest;
+            break;
+          case S_COMMENT_CLOSE:
+            if (--nest == 0) next = S_COMMENT_END;
+            break;
+          default:
+            break;
+        }
       }
+      state = next;
+    }
+    if (it == end(code)) {
+      // 入力の末尾は改行として扱うので、末尾に改行がなくてもコピーせずに済む。
+      if (dfa.next(state, CC_NEWLINE) != S_DEAD) state = S_START;
+    }
+    TokenType type = dfa.accept(state);
+    if (type == TokenType::UNKNOWN) {
+      return LexResult{static_cast<std::size_t>(head - begin(code)), true};
     }
+    auto const offset = static_cast<std::uint32_t>(head - begin(code));
+    auto const length = static_cast<std::uint32_t>(it - head);
+    SymbolKind symbol = SymbolKind::NONE;
+    if (type == TokenType::IDENTIFIER || type == TokenType::SYMBOL) {
+      symbol = to_symbol_kind(StringRef(head, length));
+      if (symbol != SymbolKind::NONE) type = TokenType::SYMBOL;
+    }
+    if (type == TokenType::STRING && !escaped) {
+      // ソースを指すだけで、デコードもコピーもしない。
+      tokens.push_back(Token(type, offset, length, symbol, Token::RAW_LITERAL));
+    } else if (type == TokenType::STRING) {
+      auto const inserted = decoded.insert(std::make_pair(
+          StringRef(head, length), static_cast<std::uint32_t>(literals.size())));
+      auto const literal = inserted.first->second;
+      if (inserted.second) {
+        // 長さは後で書く。
+        literals.append(sizeof(std::uint32_t), '\0');
+        extract_string(head, it, literals);
+        auto const size = static_cast<std::uint32_t>(
+            literals.size() - literal - sizeof(std::uint32_t));
+        std::memcpy(&literals[literal], &size, sizeof(size));
+      }
+      tokens.push_back(Token(type, offset, length, symbol, literal));
+    } else if (type == TokenType::IDENTIFIER) {
+      tokens.push_back(Token(type, offset, length, symbol,
+                             interner.intern(StringRef(head, length))));
+    } else if (type != TokenType::IGNORE) {
+      tokens.push_back(Token(type, offset, length, symbol));
+    }
+    head = it;
   }
-  return false;
+  return LexResult{static_cast<std::size_t>(head - begin(code)), false};
 }
 
-TokenType match_type(const_iterator head, const_iterator tail) {
-  if (comment(head, tail)) return TokenType::IGNORE;
-  if (symbol(head, tail)) return TokenType::SYMBOL;
-  if (identifier(head, tail)) return TokenType::IDENTIFIER;
-  if (decimal_integer(head, tail)) return TokenType::NUMBER;
-  if (string_token(head, tail)) return TokenType::STRING;
-  if (ignore(head, tail)) return TokenType::IGNORE;
-  return TokenType::UNKNOWN;
+// 分割位置から投機的に読んだ結果。
+struct Chunk {
+  std::size_t begin;
+  LexResult result;
+  std::vector<Token> tokens;
+  std::string literals;
+};
+
+}  // unnamed namespace
+
+std::tuple<bool, TokenVector> tokenize(SourceBufferPtr source) {
+  StringRef const code = source->str();
+  std::vector<Token> tokens;
+  std::string literals;
+  auto const result = lex(code, 0, code.size(), tokens, literals);
+  return std::make_tuple(!result.failed, TokenVector(std::move(source),
+                                                     std::move(literals),
+                                                     std::move(tokens)));
 }
 
-std::string extract_string(const_iterator head, const_iterator tail) {
-  if (*head == '"') {
-    bool escaped = false;
-    std::string new_str;
-    for(auto it(head); it != tail; ++it) {
-      if (escaped) {
-        if(*it == '"')       { new_str.push_back('"');  }
-        else if(*it == 'a')  { new_str.push_back('\a'); }
-        else if(*it == 'b')  { new_str.push_back('\b'); }
-        else if(*it == 'n')  { new_str.push_back('\n'); }
-        else if(*it == 'r')  { new_str.push_back('\r'); }
-        else if(*it == 'f')  { new_str.push_back('\f'); }
-        else if(*it == 't')  { new_str.push_back('\t'); }
-        else if(*it == 'v')  { new_str.push_back('\v'); }
-        else if(*it == '\\') { new_str.push_back('\\'); }
-        else if(*it == '0')  { new_str.push_back('\0'); }
-        else                 { new_str.push_back(*it); } // this should warn "unknown escape sequence"
-        escaped = false;
-      } else if (*it == '\\') {
-        escaped = true;
-      } else if (*it != '"') {
-        new_str.push_back(*it);
+std::tuple<bool, TokenVector> tokenize_in_parallel(SourceBufferPtr source,
+                                                   unsigned jobs) {
+  StringRef const code = source->str();
+  if (jobs == 0) {
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // 改行の位置で分割する。改行が文字列やコメントの中にあれば分割位置は
+  // トークンの境界にならないが、それは併合のときに検出する。
+  std::vector<Chunk> chunks;
+  for (unsigned i = 0; i < jobs; ++i) {
+    std::size_t position = code.size() / jobs * i;
+    if (i != 0) {
+      if (position >= code.size()) break;
+      auto const newline = static_cast<const char*>(std::memchr(
+          code.data() + position, '\n', code.size() - position));
+      if (newline == nullptr) break;
+      position = newline - code.data();
+    }
+    if (chunks.empty() || chunks.back().begin < position) {
+      chunks.push_back(Chunk{position, LexResult{0, false}, {}, {}});
+    }
+  }
+  const auto limit = [&](std::size_t i) {
+    return i + 1 < chunks.size() ? chunks[i + 1].begin : code.size();
+  };
+  const auto work = [&](std::size_t i) {
+    chunks[i].result = lex(code, chunks[i].begin, limit(i),
+                           chunks[i].tokens, chunks[i].literals);
+  };
+  std::vector<std::thread> threads;
+  for (std::size_t i = 1; i < chunks.size(); ++i) {
+    threads.emplace_back(work, i);
+  }
+  work(0);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  // 分割位置が本当のトークン境界と一致した区間だけを使う。一致しなければ、
+  // その間は逐次に読み直す。ここでは文字列表のずれを決めるだけで、
+  // トークンの書き換えとコピーは後で区間ごとに並列に行う。
+  struct Piece {
+    std::vector<Token>* tokens;
+    std::uint32_t literal_base;
+    std::size_t output;
+  };
+  std::vector<Piece> pieces;
+  std::deque<Chunk> relexed;
+  std::string literals;
+  std::size_t position = 0;
+  std::size_t size = 0;
+  bool failed = false;
+  const auto add = [&](std::vector<Token>& tokens,
+                       std::string const& chunk_literals) {
+    pieces.push_back(Piece{&tokens,
+                           static_cast<std::uint32_t>(literals.size()), size});
+    literals += chunk_literals;
+    size += tokens.size();
+  };
+  const auto relex = [&](std::size_t limit) {
+    relexed.emplace_back();
+    auto& chunk = relexed.back();
+    chunk.result = lex(code, position, limit, chunk.tokens, chunk.literals);
+    add(chunk.tokens, chunk.literals);
+    position = chunk.result.end;
+    failed = chunk.result.failed;
+  };
+  for (auto& chunk : chunks) {
+    if (position < chunk.begin) {
+      relex(chunk.begin);
+    }
+    if (failed) break;
+    if (position != chunk.begin) continue;
+    add(chunk.tokens, chunk.literals);
+    position = chunk.result.end;
+    failed = chunk.result.failed;
+    if (failed) break;
+  }
+  if (!failed && position < code.size()) {
+    relex(code.size());
+  }
+
+  std::vector<Token> tokens;
+  if (pieces.size() == 1) {
+    tokens = std::move(*pieces.front().tokens);
+  } else {
+    tokens.resize(size);
+  }
+  const auto copy = [&](Piece const& piece) {
+    auto out = tokens.begin() + piece.output;
+    for (Token const& token : *piece.tokens) {
+      *out++ = !token.decoded() ? token :
+          Token(token.type(), token.offset(), token.length(), token.symbol(),
+                token.literal() + piece.literal_base);
+    }
+  };
+  if (pieces.size() > 1) {
+    threads.clear();
+    for (std::size_t i = 1; i < pieces.size(); ++i) {
+      threads.emplace_back(copy, std::cref(pieces[i]));
+    }
+    copy(pieces.front());
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+  return std::make_tuple(!failed, TokenVector(std::move(source),
+                                              std::move(literals),
+                                              std::move(tokens)));
+}
+
+std::tuple<bool, TokenVector> retokenize(TokenVector const& tokens,
+                                         SourceBufferPtr source,
+                                         Edit const& edit) {
+  StringRef const code = source->str();
+  std::size_t const old_size = tokens.source() ? tokens.source()->size() : 0;
+  if (edit.offset + edit.removed > old_size ||
+      old_size - edit.removed + edit.inserted != code.size()) {
+    return tokenize(std::move(source));
+  }
+  const auto end_of = [](Token const& token) {
+    return std::size_t(token.offset()) + token.length();
+  };
+  // トークンは終わりの次の 1 文字まで見て切り出されるので、終わりが
+  // 編集位置より前のトークンは影響を受けない。
+  const std::size_t n = tokens.size();
+  const std::size_t kept = std::partition_point(
+      tokens.begin(), tokens.end(), [&](Token const& token) {
+        return end_of(token) < edit.offset;
+      }) - tokens.begin();
+  std::vector<Token> result;
+  result.reserve(n + 64);
+  result.insert(result.end(), tokens.begin(), tokens.begin() + kept);
+  std::size_t position = kept == 0 ? 0 : end_of(tokens[kept - 1]);
+
+  // 編集の後ろで、古いトークンの先頭と同じ位置に来るまで 1 トークンずつ
+  // 読み直す。コメントは 1 トークンなので、境界ではネストの深さも 0 に
+  // 揃っている。そこから先は古いトークンの位置をずらせばよい。
+  // 読み直したトークンのリテラルは、ひとまず別の表 added に置く。
+  std::string added;
+  const std::size_t edit_end = edit.offset + edit.inserted;
+  std::size_t next = kept;
+  bool failed = false;
+  bool synchronized = false;
+  while (!failed && position < code.size()) {
+    if (position >= edit_end) {
+      const std::size_t old_position = position - edit.inserted + edit.removed;
+      while (next < n && tokens[next].offset() < old_position) {
+        ++next;
+      }
+      if (next < n && tokens[next].offset() == old_position) {
+        synchronized = true;
+        break;
       }
     }
-    return new_str;
+    const auto lexed = lex(code, position, position + 1, result, added);
+    position = lexed.end;
+    failed = lexed.failed;
+  }
+  const std::size_t relexed_end = result.size();
+  std::size_t tail = relexed_end;
+  if (synchronized) {
+    // 最後のトークンまでを古い列から写す。その後ろで失敗していたか
+    // どうかは分からないので、残りは読み直す。
+    const auto offset_delta =
+        static_cast<std::uint32_t>(edit.inserted - edit.removed);
+    for (std::size_t i = next; i < n; ++i) {
+      Token const& token = tokens[i];
+      result.push_back(Token(token.type(), token.offset() + offset_delta,
+                             token.length(), token.symbol(), token.literal()));
+    }
+    tail = result.size();
+    failed = lex(code, end_of(result.back()), code.size(), result,
+                 added).failed;
+  }
+  if (added.empty()) {
+    // 古いトークンのリテラルは古い表の位置のままでよいので、表を共有する。
+    // 使われなくなった項目は残るが、表が伸びることはない。
+    return std::make_tuple(!failed, TokenVector(std::move(source), tokens,
+                                                std::move(result)));
   }
-  return std::string{head, tail};
+  // 使われているリテラルだけを新しい表に写す。表を丸ごと引き継いで足すと、
+  // 編集のたびに伸び続ける。元の表で同じ位置を共有していたものは、写した
+  // 後も共有する。
+  std::string literals;
+  std::unordered_map<std::uint32_t, std::uint32_t> moved;
+  std::unordered_map<std::uint32_t, std::uint32_t> moved_added;
+  for (std::size_t i = 0; i < result.size(); ++i) {
+    Token& token = result[i];
+    if (!token.decoded()) continue;
+    const bool relexed = (kept <= i && i < relexed_end) || tail <= i;
+    std::string const& from = relexed ? added : tokens.literals();
+    auto const inserted = (relexed ? moved_added : moved).insert(
+        std::make_pair(token.literal(), 0u));
+    if (inserted.second) {
+      inserted.first->second = TokenVector::add_literal(
+          literals, literal_at(from, token.literal()));
+    }
+    token = Token(token.type(), token.offset(), token.length(),
+                  token.symbol(), inserted.first->second);
+  }
+  return std::make_tuple(!failed, TokenVector(std::move(source),
+                                              std::move(literals),
+                                              std::move(result)));
 }
 
-std::tuple<bool, TokenVector> tokenize(std::istream& is) {
-  using std::begin;
-  using std::end;
-  using istrbuf_itr = std::istreambuf_iterator<char>;
-  std::string const code(std::string{istrbuf_itr(is), istrbuf_itr()} + '\n');
-  // ファイルの末尾が改行で終わっているほうが処理しやすい。
-  TokenVector tokens;
-  TokenType prev = TokenType::UNKNOWN;
-  const_iterator head(begin(code));
-  int line = 1;
-  for (auto it(begin(code)); it != end(code); ++it) {
-    TokenType next = match_type(head, std::next(it));
-    if (prev != TokenType::UNKNOWN && next == TokenType::UNKNOWN) {
-      if (prev != TokenType::IGNORE) {
-        tokens.push_back(Token(prev, extract_string(head, it), line));
+TokenStream::Mark::Mark(TokenStream* stream, std::size_t position)
+  : stream_(stream), position_(position)
+{}
+
+TokenStream::Mark::Mark(Mark&& other)
+  : stream_(other.stream_), position_(other.position_)
+{
+  other.stream_ = nullptr;
+}
+
+TokenStream::Mark::~Mark() {
+  if (stream_) stream_->release(position_);
+}
+
+TokenStream::TokenStream(TokenVector tokens)
+  : vector_(std::move(tokens)),
+    source_(vector_.source()),
+    chunk_size_(0),
+    streaming_(false),
+    done_(true),
+    failed_(false),
+    head_(0),
+    literal_base_(0),
+    data_(vector_.empty() ? nullptr : &vector_[0]),
+    base_(0),
+    count_(vector_.size()),
+    position_(0),
+    peak_(vector_.size())
+{}
+
+TokenStream::TokenStream(SourceBufferPtr source, std::size_t chunk_size)
+  : source_(std::move(source)),
+    chunk_size_(std::max<std::size_t>(chunk_size, 1)),
+    streaming_(true),
+    done_(source_->size() == 0),
+    failed_(false),
+    head_(0),
+    literal_base_(0),
+    data_(nullptr),
+    base_(0),
+    count_(0),
+    position_(0),
+    peak_(0)
+{}
+
+StringRef TokenStream::str(Token const& token) const {
+  if (!streaming_) return vector_.str(token);
+  if (token.decoded()) {
+    return literal_at(literals_, token.literal() - literal_base_);
+  }
+  if (token.type() == TokenType::STRING) {
+    return raw_literal(source_->data(), token);
+  }
+  return StringRef(source_->data() + token.offset(), token.length());
+}
+
+auto TokenStream::mark() -> Mark {
+  if (!streaming_) return Mark(nullptr, position_);
+  marks_.push_back(position_);
+  return Mark(this, position_);
+}
+
+void TokenStream::release(std::size_t position) {
+  // Mark はほぼ作ったのと逆の順に消えるので、後ろから探す。
+  const auto it = std::find(marks_.rbegin(), marks_.rend(), position);
+  marks_.erase(std::next(it).base());
+}
+
+Token const* TokenStream::fill() {
+  while (position_ - base_ >= window_.size()) {
+    if (done_) return nullptr;
+    discard();
+    StringRef const code = source_->str();
+    const std::size_t first = window_.size();
+    const std::size_t limit = std::min(code.size(), head_ + chunk_size_);
+    const auto result = lex(code, head_, limit, window_, literals_);
+    // lex はリテラル表の先頭からの位置を付けるので、通しの位置に直す。
+    for (std::size_t i = first; i < window_.size(); ++i) {
+      Token const& token = window_[i];
+      if (token.decoded()) {
+        window_[i] = Token(token.type(), token.offset(), token.length(),
+                           token.symbol(),
+                           token.literal() +
+                               static_cast<std::uint32_t>(literal_base_));
       }
-      head = it;
-      prev = match_type(head, std::next(head));
-    } else {
-      prev = next;
     }
-    if (*it == '\n') ++line;
+    head_ = result.end;
+    failed_ = result.failed;
+    done_ = result.failed || head_ == code.size();
+    data_ = window_.data();
+    count_ = window_.size();
+    peak_ = std::max(peak_, count_);
+  }
+  return data_ + (position_ - base_);
+}
+
+void TokenStream::discard() {
+  std::size_t keep = position_;
+  for (std::size_t mark : marks_) keep = std::min(keep, mark);
+  const std::size_t drop = keep - base_;
+  // 捨てる分が窓の半分に満たなければ詰めない。詰める手間は償却で O(1)。
+  if (drop == 0 || drop < window_.size() / 2) return;
+  window_.erase(window_.begin(), window_.begin() + drop);
+  base_ = keep;
+  // 同じリテラルは表の同じ位置を共有するので、窓の中で最も前の位置まで
+  // 捨てられる。
+  std::size_t cut = literals_.size();
+  for (Token const& token : window_) {
+    if (token.decoded()) {
+      cut = std::min<std::size_t>(cut, token.literal() - literal_base_);
+    }
   }
-  ++head; // head とend(code) が一致した時が、最後まで食べた時である。
-  return std::make_tuple(head == end(code), tokens);
+  literals_.erase(0, cut);
+  literal_base_ += cut;
+  data_ = window_.data();
+  count_ = window_.size();
 }
 
+// リテラル表での位置は表ごとに違うので、STRING トークンでは比べない。
 bool operator==(Token const& lhs, Token const& rhs) {
-  return lhs.type() == rhs.type()
-      && lhs.str()  == rhs.str()
-      && lhs.line() == rhs.line();
+  return lhs.type()   == rhs.type()
+      && lhs.symbol() == rhs.symbol()
+      && lhs.offset() == rhs.offset()
+      && lhs.length() == rhs.length()
+      && (lhs.type() == TokenType::STRING || lhs.id() == rhs.id());
 }
 bool operator!=(Token const& lhs, Token const& rhs) {
   return !( lhs == rhs );
 }
 
+bool operator==(TokenVector const& lhs, TokenVector const& rhs) {
+  if (lhs.size() != rhs.size()) return false;
+  for (TokenVector::size_type i = 0; i < lhs.size(); ++i) {
+    if (lhs[i].type() != rhs[i].type() ||
+        lhs[i].symbol() != rhs[i].symbol() ||
+        lhs.location(lhs[i]).line != rhs.location(rhs[i]).line ||
+        lhs.str(lhs[i]) != rhs.str(rhs[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+bool operator!=(TokenVector const& lhs, TokenVector const& rhs) {
+  return !( lhs == rhs );
+}
+
 }  // namespace klang
@@ -1,14 +1,21 @@
 #ifndef KMC_KLANG_LEXER_HPP
 #define KMC_KLANG_LEXER_HPP
 
+#include "interner.hpp"
+#include "source.hpp"
+#include "string_ref.hpp"
+
+#include <cstddef>
+#include <cstdint>
 #include <istream>
+#include <memory>
 #include <string>
 #include <tuple>
 #include <vector>
 
 namespace klang {
 
-enum class TokenType {
+enum class TokenType : std::uint8_t {
   IDENTIFIER,
   NUMBER,
   SYMBOL,
@@ -18,25 +25,232 @@ enum class TokenType {
   UNKNOWN
 };
 
+// 記号とキーワード。SYMBOL トークンはどれに当たるかを持つ。
+enum class SymbolKind : std::uint8_t {
+  NONE,
+  TILDE,              // ~
+  PLUS,               // +
+  MINUS,              // -
+  ASTERISK,           // *
+  SLASH,              // /
+  PERCENT,            // %
+  ASSIGN,             // :=
+  ADD_ASSIGN,         // :+=
+  SUBTRACT_ASSIGN,    // :-=
+  MULTIPLY_ASSIGN,    // :*=
+  DIVIDE_ASSIGN,      // :/=
+  MODULO_ASSIGN,      // :%=
+  EQUAL,              // =
+  NOT_EQUAL,          // =/
+  LESS,               // <
+  GREATER,            // >
+  LESS_OR_EQUAL,      // <=
+  GREATER_OR_EQUAL,   // >=
+  SEMICOLON,          // ;
+  LEFT_PAREN,         // (
+  RIGHT_PAREN,        // )
+  LEFT_BRACE,         // {
+  RIGHT_BRACE,        // }
+  ARROW,              // ->
+  CLOSE_COMMENT,      // ~}
+  AND,
+  OR,
+  NOT,
+  INT,
+  DEF,
+  VAR,
+  IF,
+  ELSE,
+  WHILE,
+  FOR,
+  BREAK,
+  CONTINUE,
+  RETURN,
+  COMMA               // , (字句解析器はまだ生成しない)
+};
+
+// 記号かキーワードなら対応する SymbolKind を、そうでなければ NONE を返す。
+SymbolKind to_symbol_kind(StringRef str);
+StringRef to_string(SymbolKind kind);
+
+// トークンは文字列を持たず、ソース上の位置だけを持つ。行と列は
+// SourceBuffer::locate で必要になったときに求める。
+// IDENTIFIER トークンは Interner::global() での番号を、STRING トークンは
+// TokenVector が持つデコード済みのリテラル表での位置を value に持つ。
+// エスケープを含まない STRING トークンはデコードせず、value は RAW_LITERAL
+// になる。その文字列はソース上の引用符の内側をそのまま指す。
 class Token {
  public:
+  static constexpr std::uint32_t RAW_LITERAL = 0xffffffff;
   Token();
-  Token(TokenType type, const std::string& str, int line);
+  Token(TokenType type, std::uint32_t offset, std::uint32_t length,
+        SymbolKind symbol = SymbolKind::NONE, std::uint32_t value = 0);
   TokenType type() const;
-  std::string str() const;
-  int line() const;
+  SymbolKind symbol() const;
+  std::uint32_t offset() const;
+  std::uint32_t length() const;
+  Interner::Id id() const;
+  std::uint32_t literal() const;
+  // リテラル表にデコードした文字列を持つか。
+  bool decoded() const {
+    return type_ == TokenType::STRING && value_ != RAW_LITERAL;
+  }
  private:
   TokenType type_;
-  std::string str_;
-  int line_;
+  SymbolKind symbol_;
+  std::uint32_t offset_;
+  std::uint32_t length_;
+  std::uint32_t value_;
 };
 
+static_assert(sizeof(Token) <= 16, "Token should fit in 16 bytes");
+
 bool operator==(Token const& lhs, Token const& rhs);
 bool operator!=(Token const& lhs, Token const& rhs);
 
-typedef std::vector<Token> TokenVector;
+class TokenVector {
+ public:
+  using value_type = Token;
+  using const_iterator = std::vector<Token>::const_iterator;
+  using size_type = std::vector<Token>::size_type;
+  TokenVector();
+  TokenVector(SourceBufferPtr source,
+              std::string literals,
+              std::vector<Token> tokens);
+  // literals_from とリテラル表を共有する。tokens の value はその表を指すこと。
+  TokenVector(SourceBufferPtr source,
+              TokenVector const& literals_from,
+              std::vector<Token> tokens);
+  const_iterator begin() const { return data_->tokens.begin(); }
+  const_iterator end() const { return data_->tokens.end(); }
+  size_type size() const { return data_->tokens.size(); }
+  bool empty() const { return data_->tokens.empty(); }
+  Token const& operator[](size_type i) const { return data_->tokens[i]; }
+  StringRef str(Token const& token) const;
+  Location location(Token const& token) const {
+    return data_->source->locate(token.offset());
+  }
+  SourceBufferPtr const& source() const { return data_->source; }
+  // リテラル表には、長さ 4 バイトに続けてデコードした文字列を置く。
+  // エスケープを含む STRING トークンだけがここを使う。
+  std::string const& literals() const { return *data_->literals; }
+  // literals の末尾に str を加え、その位置を返す。
+  static std::uint32_t add_literal(std::string& literals, StringRef str);
+ private:
+  // 作った後は変更しないので、コピーの間で共有する。
+  struct Data {
+    SourceBufferPtr source;
+    std::shared_ptr<const std::string> literals;
+    std::vector<Token> tokens;
+  };
+  std::shared_ptr<const Data> data_;
+};
+
+bool operator==(TokenVector const& lhs, TokenVector const& rhs);
+bool operator!=(TokenVector const& lhs, TokenVector const& rhs);
 
 std::tuple<bool, TokenVector> tokenize(std::istream& is);
+std::tuple<bool, TokenVector> tokenize(SourceBufferPtr source);
+// code の寿命は呼び出し側が保証する。
+std::tuple<bool, TokenVector> tokenize(StringRef code);
+// 入力を改行の位置で jobs 個に分けて並列に字句解析する。結果は tokenize と
+// 同じ。jobs が 0 ならハードウェアのスレッド数を使う。
+std::tuple<bool, TokenVector> tokenize_in_parallel(SourceBufferPtr source,
+                                                   unsigned jobs = 0);
+// ファイルを mmap して字句解析する。開けなければ失敗を返す。
+std::tuple<bool, TokenVector> tokenize_file(const std::string& path);
+
+// ソースの [offset, offset + removed) を inserted バイトの文字列で
+// 置き換える編集。
+struct Edit {
+  std::size_t offset;
+  std::size_t removed;
+  std::size_t inserted;
+};
+
+// tokens のソースに edit を施したものが source のとき、編集の直前の
+// トークン境界から、古いトークン列と境界が揃うところまでだけを読み直して
+// 古いトークンをつなぎ合わせる。結果は tokenize(source) と同じ。
+// 読み直すのは編集の周りだけだが、トークン列は丸ごと写すので、費用は
+// トークン数に比例する。リテラル表は、読み直した範囲にエスケープを含む
+// リテラルがなければ写さずに共有する。
+std::tuple<bool, TokenVector> retokenize(TokenVector const& tokens,
+                                         SourceBufferPtr source,
+                                         Edit const& edit);
+
+// 必要になった分だけ字句解析するトークン列。先読みの窓だけを保持し、
+// 現在位置と生きている Mark のどれよりも前のトークンは捨てる。
+// TokenVector から作ったときは全トークンを持ち、何も捨てない。
+class TokenStream {
+ public:
+  // 位置を覚えておき、reset で戻れるようにする。
+  // Mark が生きている間は、その位置以降のトークンを捨てない。
+  class Mark {
+   public:
+    Mark(Mark&& other);
+    ~Mark();
+    Mark(Mark const&) = delete;
+    Mark& operator=(Mark const&) = delete;
+    std::size_t position() const { return position_; }
+   private:
+    friend class TokenStream;
+    Mark(TokenStream* stream, std::size_t position);
+    TokenStream* stream_;
+    std::size_t position_;
+  };
+  explicit TokenStream(TokenVector tokens);
+  // source を chunk_size バイトずつ字句解析する。
+  explicit TokenStream(SourceBufferPtr source, std::size_t chunk_size = 4096);
+  // Mark が生きている間は移動しないこと。
+  TokenStream(TokenStream&&) = default;
+  // 現在位置のトークン。末尾なら nullptr。
+  Token const* peek() {
+    const std::size_t i = position_ - base_;
+    return i < count_ ? data_ + i : fill();
+  }
+  // peek() が nullptr でないときだけ呼ぶ。
+  void advance() { ++position_; }
+  std::size_t position() const { return position_; }
+  // 捨てておらず、すでに読んだ位置のトークン。
+  Token const& operator[](std::size_t position) const {
+    return data_[position - base_];
+  }
+  StringRef str(Token const& token) const;
+  Mark mark();
+  void reset(Mark const& mark) { position_ = mark.position(); }
+  // 捨てていない位置に移る。
+  void seek(std::size_t position) { position_ = position; }
+  // 字句解析に失敗したか。失敗した位置が列の末尾になる。
+  bool failed() const { return failed_; }
+  // TokenVector から作ったときはそれを、そうでなければ nullptr を返す。
+  TokenVector const* vector() const {
+    return streaming_ ? nullptr : &vector_;
+  }
+  // 今保持しているトークンの数と、その最大値。
+  std::size_t window_size() const { return count_; }
+  std::size_t peak_window_size() const { return peak_; }
+ private:
+  Token const* fill();
+  void discard();
+  void release(std::size_t position);
+  TokenVector vector_;
+  SourceBufferPtr source_;
+  std::size_t chunk_size_;
+  bool streaming_;
+  bool done_;
+  bool failed_;
+  std::size_t head_;  // 次に字句解析するソース上の位置
+  std::vector<Token> window_;
+  // STRING トークンのリテラル表での位置は、捨てた分も数えた通しの位置。
+  std::string literals_;
+  std::size_t literal_base_;
+  std::vector<std::size_t> marks_;
+  Token const* data_;
+  std::size_t base_;  // data_[0] の位置
+  std::size_t count_;
+  std::size_t position_;
+  std::size_t peak_;
+};
 
 }  // namespace klang
 
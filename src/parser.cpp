@@ -2,94 +2,497 @@
 
 #include "ast_data.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
 namespace klang {
 
-Parser::Parser(TokenVector tokens)
+namespace {
+
+template <typename T>
+ast::NodePtr<T> downcast(ast::ExpressionPtr expression) {
+  return ast::NodePtr<T>(static_cast<T*>(expression.release()));
+}
+
+// 明示的なスタックでは子の結果を Base として受け取るので、読んだ規則の型に
+// 戻す。
+template <typename T>
+ast::NodePtr<T> take(ast::BasePtr node) {
+  return ast::NodePtr<T>(static_cast<T*>(node.release()));
+}
+
+template <typename T>
+std::vector<ast::NodePtr<T>> take_items(std::vector<ast::BasePtr>& items,
+                                        std::size_t base) {
+  std::vector<ast::NodePtr<T>> ret;
+  ret.reserve(items.size() - base);
+  for (std::size_t i = base; i < items.size(); ++i) {
+    ret.push_back(take<T>(std::move(items[i])));
+  }
+  items.resize(base);
+  return ret;
+}
+
+template <typename Node, typename Lhs, typename Rhs>
+ast::ExpressionPtr make_binary(ast::Arena& arena,
+                               ast::ExpressionPtr lhs,
+                               ast::ExpressionPtr rhs) {
+  return arena.make<Node>(downcast<Lhs>(std::move(lhs)),
+                          downcast<Rhs>(std::move(rhs)));
+}
+
+enum Precedence {
+  NO_PRECEDENCE,
+  ASSIGN_PRECEDENCE,
+  OR_PRECEDENCE,
+  AND_PRECEDENCE,
+  COMPARATIVE_PRECEDENCE,
+  ADDITIVE_PRECEDENCE,
+  MULTIPLICATIVE_PRECEDENCE,
+  MAX_PRECEDENCE = MULTIPLICATIVE_PRECEDENCE
+};
+
+struct BinaryOperator {
+  int precedence;
+  bool left_associative;
+  ast::ExpressionPtr (*make)(ast::Arena&, ast::ExpressionPtr, ast::ExpressionPtr);
+};
+
+BinaryOperator const& binary_operator(SymbolKind symbol) {
+  using namespace ast;
+  static const BinaryOperator none{NO_PRECEDENCE, false, nullptr};
+  static const BinaryOperator assign{ASSIGN_PRECEDENCE, false,
+      make_binary<AssignExpressionData, OrExpression, OrExpression>};
+  static const BinaryOperator add_assign{ASSIGN_PRECEDENCE, false,
+      make_binary<AddAssignExpressionData, OrExpression, OrExpression>};
+  static const BinaryOperator subtract_assign{ASSIGN_PRECEDENCE, false,
+      make_binary<SubtractAssignExpressionData, OrExpression, OrExpression>};
+  static const BinaryOperator multiply_assign{ASSIGN_PRECEDENCE, false,
+      make_binary<MultiplyAssignExpressionData, OrExpression, OrExpression>};
+  static const BinaryOperator divide_assign{ASSIGN_PRECEDENCE, false,
+      make_binary<DivideAssignExpressionData, OrExpression, OrExpression>};
+  static const BinaryOperator modulo_assign{ASSIGN_PRECEDENCE, false,
+      make_binary<ModuloAssignExpressionData, OrExpression, OrExpression>};
+  static const BinaryOperator or_{OR_PRECEDENCE, true,
+      make_binary<OrExpressionData, OrExpression, AndExpression>};
+  static const BinaryOperator and_{AND_PRECEDENCE, true,
+      make_binary<AndExpressionData, AndExpression, ComparativeExpression>};
+  static const BinaryOperator equal{COMPARATIVE_PRECEDENCE, false,
+      make_binary<EqualExpressionData,
+                  AdditiveExpression, AdditiveExpression>};
+  static const BinaryOperator not_equal{COMPARATIVE_PRECEDENCE, false,
+      make_binary<NotEqualExpressionData,
+                  AdditiveExpression, AdditiveExpression>};
+  static const BinaryOperator less{COMPARATIVE_PRECEDENCE, false,
+      make_binary<LessExpressionData,
+                  AdditiveExpression, AdditiveExpression>};
+  static const BinaryOperator greater{COMPARATIVE_PRECEDENCE, false,
+      make_binary<GreaterExpressionData,
+                  AdditiveExpression, AdditiveExpression>};
+  static const BinaryOperator less_or_equal{COMPARATIVE_PRECEDENCE, false,
+      make_binary<LessOrEqualExpressionData,
+                  AdditiveExpression, AdditiveExpression>};
+  static const BinaryOperator greater_or_equal{COMPARATIVE_PRECEDENCE, false,
+      make_binary<GreaterOrEqualExpressionData,
+                  AdditiveExpression, AdditiveExpression>};
+  static const BinaryOperator add{ADDITIVE_PRECEDENCE, true,
+      make_binary<AddExpressionData,
+                  AdditiveExpression, MultiplicativeExpression>};
+  static const BinaryOperator subtract{ADDITIVE_PRECEDENCE, true,
+      make_binary<SubtractExpressionData,
+                  AdditiveExpression, MultiplicativeExpression>};
+  static const BinaryOperator multiply{MULTIPLICATIVE_PRECEDENCE, true,
+      make_binary<MultiplyExpressionData,
+                  MultiplicativeExpression, UnaryExpression>};
+  static const BinaryOperator divide{MULTIPLICATIVE_PRECEDENCE, true,
+      make_binary<DivideExpressionData,
+                  MultiplicativeExpression, UnaryExpression>};
+  static const BinaryOperator modulo{MULTIPLICATIVE_PRECEDENCE, true,
+      make_binary<ModuloExpressionData,
+                  MultiplicativeExpression, UnaryExpression>};
+  switch (symbol) {
+    case SymbolKind::ASSIGN: return assign;
+    case SymbolKind::ADD_ASSIGN: return add_assign;
+    case SymbolKind::SUBTRACT_ASSIGN: return subtract_assign;
+    case SymbolKind::MULTIPLY_ASSIGN: return multiply_assign;
+    case SymbolKind::DIVIDE_ASSIGN: return divide_assign;
+    case SymbolKind::MODULO_ASSIGN: return modulo_assign;
+    case SymbolKind::OR: return or_;
+    case SymbolKind::AND: return and_;
+    case SymbolKind::EQUAL: return equal;
+    case SymbolKind::NOT_EQUAL: return not_equal;
+    case SymbolKind::LESS: return less;
+    case SymbolKind::GREATER: return greater;
+    case SymbolKind::LESS_OR_EQUAL: return less_or_equal;
+    case SymbolKind::GREATER_OR_EQUAL: return greater_or_equal;
+    case SymbolKind::PLUS: return add;
+    case SymbolKind::MINUS: return subtract;
+    case SymbolKind::ASTERISK: return multiply;
+    case SymbolKind::SLASH: return divide;
+    case SymbolKind::PERCENT: return modulo;
+    default: return none;
+  }
+}
+
+constexpr std::uint64_t symbols(SymbolKind first, SymbolKind last) {
+  return first == last ? ParseError::symbol(first)
+      : ParseError::symbol(first) |
+        symbols(static_cast<SymbolKind>(static_cast<int>(first) + 1), last);
+}
+
+// 読めなかったときに expected に入れる集合。二項演算子と、被演算子の
+// 先頭になりうるもの。
+constexpr std::uint64_t BINARY_OPERATORS =
+    symbols(SymbolKind::PLUS, SymbolKind::GREATER_OR_EQUAL) |
+    ParseError::symbol(SymbolKind::AND) | ParseError::symbol(SymbolKind::OR);
+constexpr std::uint64_t OPERAND_FIRST =
+    ParseError::symbol(SymbolKind::NOT) |
+    ParseError::symbol(SymbolKind::TILDE) |
+    ParseError::symbol(SymbolKind::LEFT_PAREN) |
+    ParseError::IDENTIFIER | ParseError::NUMBER | ParseError::CHARACTER |
+    ParseError::STRING;
+
+}  // namespace
+
+Parser::Parser(TokenVector tokens, bool memoize)
     : tokens_(std::move(tokens)),
-      current_(std::begin(tokens_))
+      failures_(memoize ? tokens_.vector()->size() + 1 : 0, 0),
+      failures_begin_(failures_.size()),
+      failures_end_(0),
+      arena_(std::make_shared<ast::Arena>()),
+      function_offset_(0),
+      explicit_stack_(false),
+      nesting_limit_exceeded_(false),
+      nesting_limit_(0),
+      depth_(0),
+      succeeded_(false),
+      recover_(false),
+      farthest_(0),
+      expected_(0)
+{}
+
+Parser::Parser(TokenStream tokens)
+    : tokens_(std::move(tokens)),
+      failures_begin_(0),
+      failures_end_(0),
+      arena_(std::make_shared<ast::Arena>()),
+      function_offset_(0),
+      explicit_stack_(false),
+      nesting_limit_exceeded_(false),
+      nesting_limit_(0),
+      depth_(0),
+      succeeded_(false),
+      recover_(false),
+      farthest_(0),
+      expected_(0)
+{}
+
+Parser::Frame::Frame(Rule rule, Pointer start, int precedence,
+                     std::size_t base)
+    : rule(rule), step(0), precedence(precedence),
+      max_precedence(MAX_PRECEDENCE + 1), nested(false), is_mutable(false),
+      symbol(SymbolKind::NONE), start(std::move(start)), base(base),
+      position(0)
 {}
 
-bool Parser::parse_symbol(const char* str) {
-  if (current_type() == TokenType::SYMBOL &&
-      current_string() == std::string{str}) {
+void Parser::use_explicit_stack(std::size_t nesting_limit) {
+  explicit_stack_ = true;
+  nesting_limit_ = nesting_limit;
+}
+
+void Parser::recover_from_errors() {
+  recover_ = true;
+}
+
+bool Parser::parse_symbol(SymbolKind symbol) {
+  if (current_symbol() == symbol) {
     advance(1);
     return true;
   } else {
+    expect(ParseError::symbol(symbol));
     return false;
   }
 }
 
-ast::IdentifierPtr Parser::parse_identifier() {
+ParseResult<ast::Identifier> Parser::parse_identifier() {
   if (current_type() == TokenType::IDENTIFIER) {
-    auto ret = make_unique<ast::IdentifierData>(current_string());
+    Token const& token = *tokens_.peek();
+    auto ret = arena_->make<ast::IdentifierData>(
+        token.id(), token.offset() - function_offset_);
     advance(1);
-    return std::move(ret);
+    return make_right(std::move(ret));
   } else {
-    return nullptr;
+    expect(ParseError::IDENTIFIER);
+    return error();
   }
 }
 
-ast::TypePtr Parser::parse_type() {
+ParseResult<ast::Type> Parser::parse_type() {
   if (current_type() == TokenType::SYMBOL) {
-    auto ret = make_unique<ast::TypeData>(current_string());
+    auto ret = arena_->make<ast::TypeData>(
+        Interner::global().intern(current_string()),
+        tokens_.peek()->offset() - function_offset_);
     advance(1);
-    return std::move(ret);
+    return make_right(std::move(ret));
   } else {
-    return nullptr;
+    expect(ParseError::TYPE);
+    return error();
   }
 }
 
-ast::IntegerLiteralPtr Parser::parse_integer_literal() {
+ParseResult<ast::IntegerLiteral> Parser::parse_integer_literal() {
   if (current_type() == TokenType::NUMBER) {
-    auto ret = make_unique<ast::IntegerLiteralData>(current_string());
+    auto ret = arena_->make<ast::IntegerLiteralData>(
+        arena_->copy(current_string()));
     advance(1);
-    return std::move(ret);
+    return make_right(std::move(ret));
   } else {
-    return nullptr;
+    expect(ParseError::NUMBER);
+    return error();
   }
 }
 
-ast::CharacterLiteralPtr Parser::parse_character_literal() {
+ParseResult<ast::CharacterLiteral> Parser::parse_character_literal() {
   if (current_type() == TokenType::CHARACTER) {
+    auto ret = arena_->make<ast::CharacterLiteralData>(
+        arena_->copy(current_string()));
     advance(1);
-    return make_unique<ast::CharacterLiteralData>(current_string());
+    return make_right(std::move(ret));
   } else {
-    return nullptr;
+    expect(ParseError::CHARACTER);
+    return error();
   }
 }
 
-ast::StringLiteralPtr Parser::parse_string_literal() {
+ParseResult<ast::StringLiteral> Parser::parse_string_literal() {
   if (current_type() == TokenType::STRING) {
+    auto ret = arena_->make<ast::StringLiteralData>(
+        arena_->copy(current_string()));
     advance(1);
-    return make_unique<ast::StringLiteralData>(current_string());
+    return make_right(std::move(ret));
   } else {
-    return nullptr;
+    expect(ParseError::STRING);
+    return error();
   }
 }
 
 ast::TranslationUnitPtr Parser::parse_translation_unit() {
   std::vector<ast::FunctionDefinitionPtr> functions;
-  while (auto function = parse_function_definition()) {
-    functions.push_back(std::move(function));
+  std::vector<ast::TokenRange> ranges;
+  while (true) {
+    const std::size_t begin = tokens_.position();
+    if (auto function = parse_function_definition()) {
+      functions.push_back(std::move(*function));
+      ranges.push_back(ast::TokenRange{begin, tokens_.position()});
+    } else if (recover_ && !is_eof() && !nesting_limit_exceeded_) {
+      recover_function_definition();
+    } else {
+      break;
+    }
+  }
+  return make_unique<ast::TranslationUnitData>(arena_, std::move(functions),
+                                               std::move(ranges));
+}
+
+ast::TranslationUnitPtr Parser::parse_translation_unit_in_parallel(
+    unsigned jobs) {
+  TokenVector const* const tokens = tokens_.vector();
+  if (!tokens) {
+    return parse_translation_unit();
+  }
+  const std::size_t first = tokens_.position();
+  std::vector<std::size_t> boundaries;
+  int depth = 0;
+  for (std::size_t i = first; i < tokens->size(); ++i) {
+    switch ((*tokens)[i].symbol()) {
+      case SymbolKind::LEFT_BRACE:
+        ++depth;
+        break;
+      case SymbolKind::RIGHT_BRACE:
+        --depth;
+        break;
+      case SymbolKind::DEF:
+        if (depth == 0) {
+          boundaries.push_back(i);
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  const std::size_t count = boundaries.size();
+  if (count == 0 || boundaries.front() != first) {
+    return parse_translation_unit();
+  }
+  // 各スレッドは誤りから回復しない。読めなかった区間からは、この Parser が
+  // 回復しながら逐次版で読む。
+  boundaries.push_back(tokens->size());
+
+  if (jobs == 0) {
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  jobs = std::min<std::size_t>(jobs, count);
+  // 各区間を、その区間の先頭から逐次版と同じように読む。
+  // ノードはスレッドごとの Parser の Arena に置き、後でまとめて引き取る。
+  std::vector<ast::FunctionDefinitionPtr> results(count);
+  std::vector<std::size_t> ends(count);
+  std::atomic<std::size_t> next{0};
+  std::vector<std::unique_ptr<Parser>> workers;
+  for (unsigned i = 0; i < jobs; ++i) {
+    workers.emplace_back(new Parser(*tokens, !failures_.empty()));
+    workers.back()->explicit_stack_ = explicit_stack_;
+    workers.back()->nesting_limit_ = nesting_limit_;
+  }
+  const auto work = [&](Parser& worker) {
+    for (std::size_t k; (k = next++) < count; ) {
+      worker.tokens_.seek(boundaries[k]);
+      results[k] = worker.parse_function_definition().value_or(nullptr);
+      ends[k] = worker.tokens_.position();
+    }
+  };
+  std::vector<std::thread> threads;
+  for (unsigned i = 1; i < jobs; ++i) {
+    threads.emplace_back(work, std::ref(*workers[i]));
+  }
+  work(*workers[0]);
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  for (auto const& worker : workers) {
+    arena_->merge(*worker->arena_);
+  }
+
+  std::vector<ast::FunctionDefinitionPtr> functions;
+  std::vector<ast::TokenRange> ranges;
+  std::size_t k = 0;
+  while (k < count && results[k] && ends[k] == boundaries[k + 1]) {
+    functions.push_back(std::move(results[k]));
+    ranges.push_back(ast::TokenRange{boundaries[k], ends[k]});
+    ++k;
+  }
+  // 区切りどおりに読めなかった区間からは、逐次版で読み直す。
+  tokens_.seek(boundaries[k]);
+  auto rest = parse_translation_unit();
+  auto* const unit = static_cast<ast::TranslationUnitData*>(rest.get());
+  auto rest_functions = unit->release_functions();
+  for (std::size_t i = 0; i < rest_functions.size(); ++i) {
+    functions.push_back(std::move(rest_functions[i]));
+    ranges.push_back(unit->ranges()[i]);
+  }
+  return make_unique<ast::TranslationUnitData>(arena_, std::move(functions),
+                                               std::move(ranges));
+}
+
+ast::TranslationUnitPtr Parser::reparse_translation_unit(
+    ast::TranslationUnitPtr old, TokenVector const& old_tokens,
+    Edit const& edit) {
+  auto* const unit =
+      old && old->kind() == ast::NodeKind::TRANSLATION_UNIT ?
+          static_cast<ast::TranslationUnitData*>(old.get()) : nullptr;
+  TokenVector const* const tokens = tokens_.vector();
+  // 誤りから回復するときは、読み飛ばした範囲と誤りを集め直すために全体を
+  // 読み直す。
+  if (!unit || !tokens || recover_ ||
+      unit->ranges().size() != unit->functions().size()) {
+    return parse_translation_unit();
+  }
+  const std::vector<ast::TokenRange> old_ranges = unit->ranges();
+  auto old_functions = unit->release_functions();
+  if (unit->arena() != arena_) {
+    arena_->merge(*unit->arena());
+  }
+  const std::size_t count = old_functions.size();
+  const auto source_begin = [&](std::size_t k) -> std::size_t {
+    return old_tokens[old_ranges[k].begin].offset();
+  };
+  const auto source_end = [&](std::size_t k) -> std::size_t {
+    Token const& last = old_tokens[old_ranges[k].end - 1];
+    return std::size_t(last.offset()) + last.length();
+  };
+  std::vector<ast::FunctionDefinitionPtr> functions;
+  std::vector<ast::TokenRange> ranges;
+  const auto reuse = [&](std::size_t k, long long token_delta) {
+    functions.push_back(std::move(old_functions[k]));
+    ranges.push_back(ast::TokenRange{
+        static_cast<std::size_t>(old_ranges[k].begin + token_delta),
+        static_cast<std::size_t>(old_ranges[k].end + token_delta)});
+  };
+
+  // retokenize と同じ理由で、終わりが編集位置より前の関数は、トークンも
+  // 読んだ結果も変わらない。
+  std::size_t k = 0;
+  for (; k < count && source_end(k) < edit.offset; ++k) {
+    reuse(k, 0);
   }
-  return make_unique<ast::TranslationUnitData>(std::move(functions));
+  if (k > 0) {
+    tokens_.seek(old_ranges[k - 1].end);
+  }
+  // 編集より後ろの関数の先頭が新しいトークン列の同じ位置にあれば、
+  // そこから先はトークンが位置以外同じなので、読んだ結果も関数の先頭の
+  // 位置をずらせば同じ。
+  const long long token_delta =
+      static_cast<long long>(tokens->size()) -
+      static_cast<long long>(old_tokens.size());
+  const long long source_delta =
+      static_cast<long long>(edit.inserted) -
+      static_cast<long long>(edit.removed);
+  const auto new_begin = [&](std::size_t k) {
+    return static_cast<long long>(old_ranges[k].begin) + token_delta;
+  };
+  std::size_t next = k;
+  while (true) {
+    const auto position = static_cast<long long>(tokens_.position());
+    while (next < count &&
+           (source_begin(next) < edit.offset + edit.removed ||
+            new_begin(next) < position)) {
+      ++next;
+    }
+    if (next < count && new_begin(next) == position &&
+        tokens_.position() < tokens->size()) {
+      Token const& token = (*tokens)[tokens_.position()];
+      if (static_cast<long long>(token.offset()) ==
+          static_cast<long long>(source_begin(next)) + source_delta) {
+        for (; next < count; ++next) {
+          static_cast<ast::FunctionDefinitionData&>(*old_functions[next])
+              .shift(source_delta);
+          reuse(next, token_delta);
+        }
+        break;
+      }
+    }
+    const std::size_t begin = tokens_.position();
+    auto function = parse_function_definition();
+    if (!function) break;
+    functions.push_back(std::move(*function));
+    ranges.push_back(ast::TokenRange{begin, tokens_.position()});
+  }
+  return make_unique<ast::TranslationUnitData>(arena_, std::move(functions),
+                                               std::move(ranges));
 }
 
-ast::FunctionDefinitionPtr Parser::parse_function_definition() {
+ParseResult<ast::FunctionDefinition> Parser::parse_function_definition() {
+  if (known_failure(Rule::FUNCTION_DEFINITION)) return error();
   const auto s = snapshot();
-  if (parse_symbol("def")) {
+  Token const* const head = tokens_.peek();
+  const std::uint32_t outer_offset = function_offset_;
+  function_offset_ = head ? head->offset() : 0;
+  if (parse_symbol(SymbolKind::DEF)) {
     if (auto function_name = parse_identifier()) {
-      if (parse_symbol("(")) {
+      if (parse_symbol(SymbolKind::LEFT_PAREN)) {
         if (auto arguments = parse_argument_list()) {
-          if (parse_symbol(")") && parse_symbol("->") && parse_symbol("(")) {
+          if (parse_symbol(SymbolKind::RIGHT_PAREN) && parse_symbol(SymbolKind::ARROW) && parse_symbol(SymbolKind::LEFT_PAREN)) {
             if (auto return_type = parse_type()) {
-              if (parse_symbol(")")) {
+              if (parse_symbol(SymbolKind::RIGHT_PAREN)) {
                 if (auto function_body = parse_compound_statement()) {
-                  return make_unique<ast::FunctionDefinitionData>(
-                      std::move(function_name),
-                      std::move(arguments),
-                      std::move(return_type),
-                      std::move(function_body));
+                  const std::uint32_t offset = function_offset_;
+                  function_offset_ = outer_offset;
+                  return make_right(arena_->make<ast::FunctionDefinitionData>(
+                      offset,
+                      std::move(*function_name),
+                      std::move(*arguments),
+                      std::move(*return_type),
+                      std::move(*function_body)));
                 }
               }
             }
@@ -98,19 +501,20 @@ ast::FunctionDefinitionPtr Parser::parse_function_definition() {
       }
     }
   }
+  function_offset_ = outer_offset;
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::FUNCTION_DEFINITION);
 }
 
-ast::ArgumentListPtr Parser::parse_argument_list() {
+ParseResult<ast::ArgumentList> Parser::parse_argument_list() {
   std::vector<ast::ArgumentPtr> arguments;
   if (auto first_argument = parse_argument()) {
-    arguments.push_back(std::move(first_argument));
+    arguments.push_back(std::move(*first_argument));
     while (true) {
       const auto s = snapshot();
-      if (parse_symbol(",")) {
+      if (parse_symbol(SymbolKind::COMMA)) {
         if (auto argument = parse_argument()) {
-          arguments.push_back(std::move(argument));
+          arguments.push_back(std::move(*argument));
           continue;
         }
       }
@@ -118,431 +522,391 @@ ast::ArgumentListPtr Parser::parse_argument_list() {
       break;
     }
   }
-  return make_unique<ast::ArgumentListData>(std::move(arguments));
+  return make_right(arena_->make<ast::ArgumentListData>(arena_->make_array(arguments)));
 }
 
-ast::ArgumentPtr Parser::parse_argument() {
+ParseResult<ast::Argument> Parser::parse_argument() {
+  if (known_failure(Rule::ARGUMENT)) return error();
   const auto s = snapshot();
   if (auto argument_type = parse_type()) {
     if (auto argument_name = parse_identifier()) {
-      return make_unique<ast::ArgumentData>(std::move(argument_type),
-                                            std::move(argument_name));
+      return make_right(arena_->make<ast::ArgumentData>(std::move(*argument_type),
+                                            std::move(*argument_name)));
     }
   }
   rewind(s);
-  return nullptr;
-}
-
-ast::StatementPtr Parser::parse_statement() {
-  if (auto statement = parse_compound_statement()) {
-    return std::move(statement);
-  } else if (auto statement = parse_if_statement()){
-    return std::move(statement);
-  } else if (auto statement = parse_while_statement()){
-    return std::move(statement);
-  } else if (auto statement = parse_for_statement()){
-    return std::move(statement);
-  } else if (auto statement = parse_return_statement()){
-    return std::move(statement);
-  } else if (auto statement = parse_break_statement()){
-    return std::move(statement);
-  } else if (auto statement = parse_continue_statement()){
-    return std::move(statement);
-  } else if (auto statement = parse_variable_definition_statement()){
-    return std::move(statement);
-  } else if (auto statement = parse_expression_statement()){
-    return std::move(statement);
-  }
-  return nullptr;
-}
-
-ast::CompoundStatementPtr Parser::parse_compound_statement() {
+  return record_failure(Rule::ARGUMENT);
+}
+
+ParseResult<ast::Statement> Parser::parse_statement() {
+  if (explicit_stack_) {
+    return result<ast::Statement>(run(Rule::STATEMENT));
+  }
+  if (known_failure(Rule::STATEMENT)) return error();
+  // 先頭のトークンで規則が一つに決まるので、バックトラックしない。
+  ParseResult<ast::Statement> statement = error();
+  switch (current_symbol()) {
+    case SymbolKind::LEFT_BRACE:
+      statement = parse_compound_statement();
+      break;
+    case SymbolKind::IF:
+      statement = parse_if_statement();
+      break;
+    case SymbolKind::WHILE:
+      statement = parse_while_statement();
+      break;
+    case SymbolKind::FOR:
+      statement = parse_for_statement();
+      break;
+    case SymbolKind::RETURN:
+      statement = parse_return_statement();
+      break;
+    case SymbolKind::BREAK:
+      statement = parse_break_statement();
+      break;
+    case SymbolKind::CONTINUE:
+      statement = parse_continue_statement();
+      break;
+    case SymbolKind::DEF:
+      statement = parse_variable_definition_statement();
+      break;
+    default:
+      statement = parse_expression_statement();
+      break;
+  }
+  if (statement) {
+    return statement;
+  }
+  return record_failure(Rule::STATEMENT);
+}
+
+ParseResult<ast::CompoundStatement> Parser::parse_compound_statement() {
+  if (explicit_stack_) {
+    return result<ast::CompoundStatement>(run(Rule::COMPOUND_STATEMENT));
+  }
+  if (known_failure(Rule::COMPOUND_STATEMENT)) return error();
   std::vector<ast::StatementPtr> statements;
   const auto s = snapshot();
-  if (parse_symbol("{")) {
-    while (auto statement = parse_statement()) {
-      statements.push_back(std::move(statement));
-    }
-    if (parse_symbol("}")) {
-      return make_unique<ast::CompoundStatementData>(std::move(statements));
+  if (parse_symbol(SymbolKind::LEFT_BRACE)) {
+    while (true) {
+      if (auto statement = parse_statement()) {
+        statements.push_back(std::move(*statement));
+      } else if (parse_symbol(SymbolKind::RIGHT_BRACE)) {
+        return make_right(arena_->make<ast::CompoundStatementData>(
+            arena_->make_array(statements)));
+      } else if (!recover_ || is_eof() || !recover_statement()) {
+        break;
+      }
     }
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::COMPOUND_STATEMENT);
 }
 
-ast::IfStatementPtr Parser::parse_if_statement() {
+ParseResult<ast::IfStatement> Parser::parse_if_statement() {
+  if (explicit_stack_) {
+    return result<ast::IfStatement>(run(Rule::IF_STATEMENT));
+  }
+  if (known_failure(Rule::IF_STATEMENT)) return error();
   const auto s = snapshot();
-  if (parse_symbol("if") && parse_symbol("(")) {
+  if (parse_symbol(SymbolKind::IF) && parse_symbol(SymbolKind::LEFT_PAREN)) {
     if (auto condition = parse_expression()) {
-      if (parse_symbol(")")) {
+      if (parse_symbol(SymbolKind::RIGHT_PAREN)) {
         if (auto compound_statement = parse_compound_statement()) {
-          return make_unique<ast::IfStatementData>(
-              std::move(condition),
-              std::move(compound_statement),
-              parse_else_statement());
+          return make_right(arena_->make<ast::IfStatementData>(
+              std::move(*condition),
+              std::move(*compound_statement),
+              parse_else_statement().value_or(nullptr)));
         }
       }
     }
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::IF_STATEMENT);
 }
 
-ast::ElseStatementPtr Parser::parse_else_statement() {
+ParseResult<ast::ElseStatement> Parser::parse_else_statement() {
+  if (explicit_stack_) {
+    return result<ast::ElseStatement>(run(Rule::ELSE_STATEMENT));
+  }
+  if (known_failure(Rule::ELSE_STATEMENT)) return error();
   const auto s = snapshot();
-  if (parse_symbol("else")) {
-    if (auto else_if_statement = parse_if_statement()) {
-      return std::move(else_if_statement);
+  if (parse_symbol(SymbolKind::ELSE)) {
+    if (current_symbol() == SymbolKind::IF) {
+      if (auto else_if_statement = parse_if_statement()) {
+        return else_if_statement;
+      }
     } else if (auto compound_statement = parse_compound_statement()) {
-      return make_unique<ast::ElseStatementData>(std::move(compound_statement));
+      return make_right(arena_->make<ast::ElseStatementData>(
+          std::move(*compound_statement)));
     }
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::ELSE_STATEMENT);
 }
 
-ast::WhileStatementPtr Parser::parse_while_statement() {
+ParseResult<ast::WhileStatement> Parser::parse_while_statement() {
+  if (explicit_stack_) {
+    return result<ast::WhileStatement>(run(Rule::WHILE_STATEMENT));
+  }
+  if (known_failure(Rule::WHILE_STATEMENT)) return error();
   const auto s = snapshot();
-  if (parse_symbol("while") && parse_symbol("(")) {
+  if (parse_symbol(SymbolKind::WHILE) && parse_symbol(SymbolKind::LEFT_PAREN)) {
     if (auto condition = parse_expression()) {
-      if (parse_symbol(")")) {
+      if (parse_symbol(SymbolKind::RIGHT_PAREN)) {
         if (auto compound_statement = parse_compound_statement()) {
-          return make_unique<ast::WhileStatementData>(
-              std::move(condition),
-              std::move(compound_statement));
+          return make_right(arena_->make<ast::WhileStatementData>(
+              std::move(*condition),
+              std::move(*compound_statement)));
         }
       }
     }
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::WHILE_STATEMENT);
 }
 
-ast::ForStatementPtr Parser::parse_for_statement() {
+ParseResult<ast::ForStatement> Parser::parse_for_statement() {
+  if (explicit_stack_) {
+    return result<ast::ForStatement>(run(Rule::FOR_STATEMENT));
+  }
+  if (known_failure(Rule::FOR_STATEMENT)) return error();
   const auto s = snapshot();
-  if (parse_symbol("for") && parse_symbol("(")) {
+  if (parse_symbol(SymbolKind::FOR) && parse_symbol(SymbolKind::LEFT_PAREN)) {
     auto init_expression = parse_expression();
-    if (parse_symbol(";")) {
+    if (parse_symbol(SymbolKind::SEMICOLON)) {
       auto cond_expression = parse_expression();
-      if (parse_symbol(";")) {
+      if (parse_symbol(SymbolKind::SEMICOLON)) {
         auto reinit_expression = parse_expression();
-        if (parse_symbol(")")) {
+        if (parse_symbol(SymbolKind::RIGHT_PAREN)) {
           if (auto compound_statement = parse_compound_statement()) {
-            return make_unique<ast::ForStatementData>(
-                std::move(init_expression),
-                std::move(cond_expression),
-                std::move(reinit_expression),
-                std::move(compound_statement));
+            return make_right(arena_->make<ast::ForStatementData>(
+                std::move(init_expression).value_or(nullptr),
+                std::move(cond_expression).value_or(nullptr),
+                std::move(reinit_expression).value_or(nullptr),
+                std::move(*compound_statement)));
           }
         }
       }
     }
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::FOR_STATEMENT);
 }
 
-ast::ReturnStatementPtr Parser::parse_return_statement() {
+ParseResult<ast::ReturnStatement> Parser::parse_return_statement() {
+  if (explicit_stack_) {
+    return result<ast::ReturnStatement>(run(Rule::RETURN_STATEMENT));
+  }
+  if (known_failure(Rule::RETURN_STATEMENT)) return error();
   const auto s = snapshot();
-  if (parse_symbol("return")) {
+  if (parse_symbol(SymbolKind::RETURN)) {
     if (auto return_value = parse_expression()) {
-      if (parse_symbol(";")) {
-        return make_unique<ast::ReturnStatementData>(std::move(return_value));
+      if (parse_symbol(SymbolKind::SEMICOLON)) {
+        return make_right(arena_->make<ast::ReturnStatementData>(
+            std::move(*return_value)));
       }
     }
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::RETURN_STATEMENT);
 }
 
-ast::BreakStatementPtr Parser::parse_break_statement() {
+ParseResult<ast::BreakStatement> Parser::parse_break_statement() {
+  if (known_failure(Rule::BREAK_STATEMENT)) return error();
   const auto s = snapshot();
-  if (parse_symbol("break") && parse_symbol(";")) {
-    return make_unique<ast::BreakStatementData>();
+  if (parse_symbol(SymbolKind::BREAK) && parse_symbol(SymbolKind::SEMICOLON)) {
+    return make_right(arena_->make<ast::BreakStatementData>());
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::BREAK_STATEMENT);
 }
 
-ast::ContinueStatementPtr Parser::parse_continue_statement() {
+ParseResult<ast::ContinueStatement> Parser::parse_continue_statement() {
+  if (known_failure(Rule::CONTINUE_STATEMENT)) return error();
   const auto s = snapshot();
-  if (parse_symbol("continue") && parse_symbol(";")) {
-    return make_unique<ast::ContinueStatementData>();
+  if (parse_symbol(SymbolKind::CONTINUE) && parse_symbol(SymbolKind::SEMICOLON)) {
+    return make_right(arena_->make<ast::ContinueStatementData>());
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::CONTINUE_STATEMENT);
 }
 
-ast::VariableDefinitionStatementPtr
+ParseResult<ast::VariableDefinitionStatement>
 Parser::parse_variable_definition_statement() {
+  if (explicit_stack_) {
+    return result<ast::VariableDefinitionStatement>(run(Rule::VARIABLE_DEFINITION_STATEMENT));
+  }
+  if (known_failure(Rule::VARIABLE_DEFINITION_STATEMENT)) return error();
   const auto s = snapshot();
   if (auto variable_definition = parse_variable_definition()) {
-    if (parse_symbol(";")) {
-      return make_unique<ast::VariableDefinitionStatementData>(
-          std::move(variable_definition));
+    if (parse_symbol(SymbolKind::SEMICOLON)) {
+      return make_right(arena_->make<ast::VariableDefinitionStatementData>(
+          std::move(*variable_definition)));
     }
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::VARIABLE_DEFINITION_STATEMENT);
 }
 
-ast::VariableDefinitionPtr Parser::parse_variable_definition() {
+ParseResult<ast::VariableDefinition> Parser::parse_variable_definition() {
+  if (explicit_stack_) {
+    return result<ast::VariableDefinition>(run(Rule::VARIABLE_DEFINITION));
+  }
+  if (known_failure(Rule::VARIABLE_DEFINITION)) return error();
   const auto s = snapshot();
-  if (parse_symbol("def")) {
+  if (parse_symbol(SymbolKind::DEF)) {
     if (auto type_name = parse_type()) {
-      const bool is_mutable = parse_symbol("var");
+      const bool is_mutable = parse_symbol(SymbolKind::VAR);
       if (auto variable_name = parse_identifier()) {
-        if (parse_symbol(":=")) {
+        if (parse_symbol(SymbolKind::ASSIGN)) {
           if (auto expression = parse_expression()) {
-            return make_unique<ast::VariableDefinitionData>(
-                std::move(type_name),
+            return make_right(arena_->make<ast::VariableDefinitionData>(
+                std::move(*type_name),
                 is_mutable,
-                std::move(variable_name),
-                std::move(expression));
+                std::move(*variable_name),
+                std::move(*expression)));
           }
         }
       }
     }
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::VARIABLE_DEFINITION);
 }
 
-ast::ExpressionStatementPtr Parser::parse_expression_statement() {
+ParseResult<ast::ExpressionStatement> Parser::parse_expression_statement() {
+  if (explicit_stack_) {
+    return result<ast::ExpressionStatement>(run(Rule::EXPRESSION_STATEMENT));
+  }
+  if (known_failure(Rule::EXPRESSION_STATEMENT)) return error();
   const auto s = snapshot();
   auto expression = parse_expression();
-  if (parse_symbol(";")) {
-    return make_unique<ast::ExpressionStatementData>(std::move(expression));
+  if (parse_symbol(SymbolKind::SEMICOLON)) {
+    return make_right(arena_->make<ast::ExpressionStatementData>(
+        std::move(expression).value_or(nullptr)));
   }
   rewind(s);
-  return nullptr;
-}
-
-ast::ExpressionPtr Parser::parse_expression() {
-  return parse_assign_expression();
+  return record_failure(Rule::EXPRESSION_STATEMENT);
 }
 
-ast::AssignExpressionPtr Parser::parse_assign_expression() {
-  if (auto lhs_expression = parse_or_expression()) {
-    const auto s = snapshot();
-    if (parse_symbol(":=")) {
-      if (auto rhs_expression = parse_or_expression()) {
-        return make_unique<ast::AssignExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if(parse_symbol(":+=")) {
-      if (auto rhs_expression = parse_or_expression()) {
-        return make_unique<ast::AddAssignExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if(parse_symbol(":-=")) {
-      if (auto rhs_expression = parse_or_expression()) {
-        return make_unique<ast::SubtractAssignExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if(parse_symbol(":*=")) {
-      if (auto rhs_expression = parse_or_expression()) {
-        return make_unique<ast::MultiplyAssignExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if(parse_symbol(":/=")) {
-      if (auto rhs_expression = parse_or_expression()) {
-        return make_unique<ast::DivideAssignExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if(parse_symbol(":%=")) {
-      if (auto rhs_expression = parse_or_expression()) {
-        return make_unique<ast::ModuloAssignExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    }
-    return std::move(lhs_expression);
+ParseResult<ast::Expression> Parser::parse_expression() {
+  if (explicit_stack_) {
+    return result<ast::Expression>(run(Rule::EXPRESSION, ASSIGN_PRECEDENCE));
   }
-  return nullptr;
-}
-
-ast::OrExpressionPtr Parser::parse_or_expression() {
-  if (auto lhs_expression = parse_and_expression()) {
-    const auto s = snapshot();
-    if (parse_symbol("or")) {
-      if (auto rhs_expression = parse_or_expression()) {
-        return make_unique<ast::OrExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-    }
-    rewind(s);
-    return std::move(lhs_expression);
+  if (known_failure(Rule::EXPRESSION)) return error();
+  if (auto expression = parse_binary_expression(ASSIGN_PRECEDENCE)) {
+    return expression;
   }
-  return nullptr;
+  return record_failure(Rule::EXPRESSION);
 }
 
-ast::AndExpressionPtr Parser::parse_and_expression() {
-  if (auto lhs_expression = parse_comparative_expression()) {
-    const auto s = snapshot();
-    if (parse_symbol("and")) {
-      if (auto rhs_expression = parse_and_expression()) {
-        return make_unique<ast::AndExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-    }
-    rewind(s);
-    return std::move(lhs_expression);
+ParseResult<ast::Expression>
+Parser::parse_binary_expression(int min_precedence) {
+  auto lhs_expression = parse_unary_expression();
+  if (!lhs_expression) {
+    return lhs_expression;
   }
-  return nullptr;
-}
-
-ast::ComparativeExpressionPtr Parser::parse_comparative_expression() {
-  if (auto lhs_expression = parse_additive_expression()) {
-    const auto s = snapshot();
-    if (parse_symbol("=")) {
-      if (auto rhs_expression = parse_additive_expression()) {
-        return make_unique<ast::EqualExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if (parse_symbol("=/")) {
-      if (auto rhs_expression = parse_additive_expression()) {
-        return make_unique<ast::NotEqualExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if (parse_symbol("<")) {
-      if (auto rhs_expression = parse_additive_expression()) {
-        return make_unique<ast::LessExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if (parse_symbol(">")) {
-      if (auto rhs_expression = parse_additive_expression()) {
-        return make_unique<ast::GreaterExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if (parse_symbol("<=")) {
-      if (auto rhs_expression = parse_additive_expression()) {
-        return make_unique<ast::LessOrEqualExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if (parse_symbol(">=")) {
-      if (auto rhs_expression = parse_additive_expression()) {
-        return make_unique<ast::GreaterOrEqualExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
+  ast::ExpressionPtr expression = std::move(*lhs_expression);
+  // 演算子を一度畳んだら、それより強い演算子はもう受け付けない。右辺が
+  // 断った演算子を外側で拾うと、弱い演算子が強い演算子の子になる。
+  // 非結合の演算子なら、同じ優先順位の演算子も受け付けない。
+  int max_precedence = MAX_PRECEDENCE + 1;
+  while (true) {
+    const auto& op = binary_operator(current_symbol());
+    if (op.precedence < min_precedence || max_precedence <= op.precedence) {
+      if (op.precedence == NO_PRECEDENCE) expect(BINARY_OPERATORS);
+      break;
     }
-    return std::move(lhs_expression);
-  }
-  return nullptr;
-}
-
-ast::AdditiveExpressionPtr Parser::parse_additive_expression() {
-  if (auto lhs_expression = parse_multiplicative_expression()) {
     const auto s = snapshot();
-    if (parse_symbol("+")) {
-      if (auto rhs_expression = parse_additive_expression()) {
-        return make_unique<ast::AddExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if (parse_symbol("-")) {
-      if (auto rhs_expression = parse_additive_expression()) {
-        return make_unique<ast::SubtractExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
+    advance(1);
+    auto rhs_expression = parse_binary_expression(op.precedence + 1);
+    if (!rhs_expression) {
       rewind(s);
+      break;
     }
-    return std::move(lhs_expression);
+    expression = op.make(*arena_, std::move(expression),
+                         std::move(*rhs_expression));
+    max_precedence = op.left_associative ? op.precedence + 1 : op.precedence;
   }
-  return nullptr;
+  return make_right(std::move(expression));
 }
 
-ast::MultiplicativeExpressionPtr Parser::parse_multiplicative_expression() {
-  if (auto lhs_expression = parse_unary_expression()) {
-    const auto s = snapshot();
-    if (parse_symbol("*")) {
-      if (auto rhs_expression = parse_multiplicative_expression()) {
-        return make_unique<ast::MultiplyExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if (parse_symbol("/")) {
-      if (auto rhs_expression = parse_multiplicative_expression()) {
-        return make_unique<ast::DivideExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    } else if (parse_symbol("%")) {
-      if (auto rhs_expression = parse_multiplicative_expression()) {
-        return make_unique<ast::ModuloExpressionData>(
-            std::move(lhs_expression), std::move(rhs_expression));
-      }
-      rewind(s);
-    }
-    return std::move(lhs_expression);
+ParseResult<ast::UnaryExpression> Parser::parse_unary_expression() {
+  if (explicit_stack_) {
+    return result<ast::UnaryExpression>(run(Rule::UNARY_EXPRESSION));
   }
-  return nullptr;
-}
-
-ast::UnaryExpressionPtr Parser::parse_unary_expression() {
+  if (known_failure(Rule::UNARY_EXPRESSION)) return error();
+  // 前置演算子を読み飛ばしてから被演算子を読み、内側から順に包む。
   const auto s = snapshot();
-  if (parse_symbol("not")) {
-    if (auto unary_expression = parse_unary_expression()) {
-      return make_unique<ast::NotExpressionData>(std::move(unary_expression));
-    }
-    rewind(s);
-  } else if (parse_symbol("~")) {
-    if (auto unary_expression = parse_unary_expression()) {
-      return make_unique<ast::MinusExpressionData>(std::move(unary_expression));
+  while (current_symbol() == SymbolKind::NOT ||
+         current_symbol() == SymbolKind::TILDE) {
+    advance(1);
+  }
+  const std::size_t operand = tokens_.position();
+  if (auto postfix_expression = parse_postfix_expression()) {
+    ast::UnaryExpressionPtr expression = std::move(*postfix_expression);
+    for (std::size_t i = operand; i != s.position(); ) {
+      --i;
+      if (tokens_[i].symbol() == SymbolKind::NOT) {
+        expression = arena_->make<ast::NotExpressionData>(
+            std::move(expression));
+      } else {
+        expression = arena_->make<ast::MinusExpressionData>(
+            std::move(expression));
+      }
     }
-    rewind(s);
-  } else if (auto postfix_expression = parse_postfix_expression()) {
-    return std::move(postfix_expression);
+    return make_right(std::move(expression));
   }
-  return nullptr;
+  expect(OPERAND_FIRST);
+  rewind(s);
+  return record_failure(Rule::UNARY_EXPRESSION);
 }
 
-ast::PostfixExpressionPtr Parser::parse_postfix_expression() {
-  if (auto postfix_expression = parse_function_call_expression()) {
-    return std::move(postfix_expression);
-  } else if (auto primary_expression = parse_primary_expression()) {
-    return std::move(primary_expression);
+ParseResult<ast::PostfixExpression> Parser::parse_postfix_expression() {
+  if (explicit_stack_) {
+    return result<ast::PostfixExpression>(run(Rule::POSTFIX_EXPRESSION));
   }
-  return nullptr;
+  if (known_failure(Rule::POSTFIX_EXPRESSION)) return error();
+  return parse_function_call_expression().or_else(
+      [this](ParseError const&) -> ParseResult<ast::PostfixExpression> {
+        if (auto primary_expression = parse_primary_expression()) {
+          return primary_expression;
+        }
+        return record_failure(Rule::POSTFIX_EXPRESSION);
+      });
 }
 
-ast::FunctionCallExpressionPtr Parser::parse_function_call_expression() {
+ParseResult<ast::FunctionCallExpression>
+Parser::parse_function_call_expression() {
+  if (explicit_stack_) {
+    return result<ast::FunctionCallExpression>(run(Rule::FUNCTION_CALL_EXPRESSION));
+  }
+  if (known_failure(Rule::FUNCTION_CALL_EXPRESSION)) return error();
   const auto s = snapshot();
   if (auto function_name = parse_identifier()) {
-    if (parse_symbol("(")) {
+    if (parse_symbol(SymbolKind::LEFT_PAREN)) {
       if (auto parameter_list = parse_parameter_list()) {
-        if (parse_symbol(")")) {
-          return make_unique<ast::FunctionCallExpressionData>(
-              std::move(function_name), std::move(parameter_list));
+        if (parse_symbol(SymbolKind::RIGHT_PAREN)) {
+          return make_right(arena_->make<ast::FunctionCallExpressionData>(
+              std::move(*function_name), std::move(*parameter_list)));
         }
       }
     }
   }
   rewind(s);
-  return nullptr;
+  return record_failure(Rule::FUNCTION_CALL_EXPRESSION);
 }
 
-ast::ParameterListPtr Parser::parse_parameter_list() {
+ParseResult<ast::ParameterList> Parser::parse_parameter_list() {
   std::vector<ast::ParameterPtr> parameters;
   if (auto first_parameter = parse_parameter()) {
-    parameters.push_back(std::move(first_parameter));
+    parameters.push_back(std::move(*first_parameter));
     while (true) {
       const auto s = snapshot();
-      if (parse_symbol(",")) {
+      if (parse_symbol(SymbolKind::COMMA)) {
         if (auto parameter = parse_parameter()) {
-          parameters.push_back(std::move(parameter));
+          parameters.push_back(std::move(*parameter));
           continue;
         }
       }
@@ -550,73 +914,617 @@ ast::ParameterListPtr Parser::parse_parameter_list() {
       break;
     }
   }
-  return make_unique<ast::ParameterListData>(std::move(parameters));
+  return make_right(arena_->make<ast::ParameterListData>(arena_->make_array(parameters)));
 }
 
-ast::ParameterPtr Parser::parse_parameter() {
-  if (auto expression = parse_expression()) {
-    return make_unique<ast::ParameterData>(std::move(expression));
-  }
-  return nullptr;
+ParseResult<ast::Parameter> Parser::parse_parameter() {
+  return parse_expression().map([this](ast::ExpressionPtr expression) {
+    return arena_->make<ast::ParameterData>(std::move(expression));
+  });
 }
 
-ast::PrimaryExpressionPtr Parser::parse_primary_expression() {
+ParseResult<ast::PrimaryExpression> Parser::parse_primary_expression() {
+  if (explicit_stack_) {
+    return result<ast::PrimaryExpression>(run(Rule::PRIMARY_EXPRESSION));
+  }
+  if (known_failure(Rule::PRIMARY_EXPRESSION)) return error();
   const auto s = snapshot();
-  if (parse_symbol("(")) {
+  if (parse_symbol(SymbolKind::LEFT_PAREN)) {
     if (auto expression = parse_expression()) {
-      if (parse_symbol(")")) {
-        return make_unique<ast::ParenthesizedExpressionData>(
-            std::move(expression));
+      if (parse_symbol(SymbolKind::RIGHT_PAREN)) {
+        return make_right(arena_->make<ast::ParenthesizedExpressionData>(
+            std::move(*expression)));
       }
     }
     rewind(s);
-  } else if (auto identifier = parse_identifier()) {
-    return make_unique<ast::IdentifierExpressionData>(
-        std::move(identifier));
+  } else if (auto primary_expression = parse_primary_leaf()) {
+    return primary_expression;
+  }
+  return record_failure(Rule::PRIMARY_EXPRESSION);
+}
+
+ParseResult<ast::PrimaryExpression> Parser::parse_primary_leaf() {
+  if (auto identifier = parse_identifier()) {
+    return make_right(arena_->make<ast::IdentifierExpressionData>(
+        std::move(*identifier)));
   } else if (auto integer_literal = parse_integer_literal()) {
-    return make_unique<ast::IntegerLiteralExpressionData>(
-        std::move(integer_literal));
+    return make_right(arena_->make<ast::IntegerLiteralExpressionData>(
+        std::move(*integer_literal)));
   } else if (auto character_literal = parse_character_literal()) {
-    return make_unique<ast::CharacterLiteralExpressionData>(
-        std::move(character_literal));
+    return make_right(arena_->make<ast::CharacterLiteralExpressionData>(
+        std::move(*character_literal)));
   } else if (auto string_literal = parse_string_literal()) {
-    return make_unique<ast::StringLiteralExpressionData>(
-        std::move(string_literal));
+    return make_right(arena_->make<ast::StringLiteralExpressionData>(
+        std::move(*string_literal)));
   }
-  return nullptr;
+  return error();
 }
 
-TokenType Parser::current_type() const {
-  return is_eof() ? TokenType::IGNORE : current_->type();
+ast::PrimaryExpressionPtr Parser::parse_simple_operand() {
+  const std::size_t start = tokens_.position();
+  const bool callee = current_type() == TokenType::IDENTIFIER;
+  auto operand = parse_primary_leaf();
+  if (!operand) return nullptr;
+  if (callee) {
+    if (current_symbol() == SymbolKind::LEFT_PAREN) {
+      tokens_.seek(start);
+      return nullptr;
+    }
+    // 再帰版が関数呼び出しを試して読めなかった分。
+    expect(ParseError::symbol(SymbolKind::LEFT_PAREN));
+  }
+  return std::move(*operand);
 }
 
-std::string Parser::current_string() const {
-  static const std::string empty_string{""};
-  return is_eof() ? empty_string : current_->str();
+bool Parser::starts_compound_operand() {
+  switch (current_symbol()) {
+    case SymbolKind::NOT:
+    case SymbolKind::TILDE:
+    case SymbolKind::LEFT_PAREN:
+      return true;
+    default:
+      return current_type() == TokenType::IDENTIFIER;
+  }
 }
 
-bool Parser::is_eof() const {
-  using std::end;
-  return current_ == end(tokens_);
+// 各規則の再帰版と同じ順に同じものを試す。子の規則は call で積み、
+// 終わると succeeded_ と result_ に結果を置いて親の次の step に戻る。
+// 失敗した規則は、再帰版と同じく読み始めた位置に戻す。
+ast::BasePtr Parser::run(Rule rule, int precedence) {
+  if (nesting_limit_exceeded_) return nullptr;
+  const std::size_t bottom = stack_.size();
+  call(rule, precedence);
+  while (stack_.size() != bottom) {
+    Frame& f = stack_.back();
+    if (nesting_limit_exceeded_) {
+      fail();
+      continue;
+    }
+    switch (f.rule) {
+      case Rule::STATEMENT:
+        if (f.step == 1) {
+          succeeded_ ? succeed(std::move(result_)) : fail();
+          break;
+        }
+        f.step = 1;
+        call_statement();
+        break;
+      case Rule::COMPOUND_STATEMENT:
+        if (f.step == 0) {
+          if (!parse_symbol(SymbolKind::LEFT_BRACE) || !enter_nesting()) {
+            fail();
+            break;
+          }
+          f.step = 1;
+        } else if (succeeded_) {
+          items_.push_back(std::move(result_));
+        } else if (parse_symbol(SymbolKind::RIGHT_BRACE)) {
+          auto statements = take_items<ast::Statement>(items_, f.base);
+          succeed(arena_->make<ast::CompoundStatementData>(
+              arena_->make_array(statements)));
+          break;
+        } else if (!recover_ || is_eof() || !recover_statement()) {
+          fail();
+          break;
+        }
+        call_statement();
+        break;
+      case Rule::IF_STATEMENT:
+        switch (f.step++) {
+          case 0:
+            if (parse_symbol(SymbolKind::IF) &&
+                parse_symbol(SymbolKind::LEFT_PAREN)) {
+              call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+            } else {
+              fail();
+            }
+            break;
+          case 1:
+            if (succeeded_ && parse_symbol(SymbolKind::RIGHT_PAREN)) {
+              f.nodes[0] = std::move(result_);
+              call(Rule::COMPOUND_STATEMENT);
+            } else {
+              fail();
+            }
+            break;
+          case 2:
+            if (succeeded_) {
+              f.nodes[1] = std::move(result_);
+              call(Rule::ELSE_STATEMENT);
+            } else {
+              fail();
+            }
+            break;
+          default:
+            succeed(arena_->make<ast::IfStatementData>(
+                take<ast::Expression>(std::move(f.nodes[0])),
+                take<ast::CompoundStatement>(std::move(f.nodes[1])),
+                succeeded_ ? take<ast::ElseStatement>(std::move(result_))
+                           : nullptr));
+            break;
+        }
+        break;
+      case Rule::ELSE_STATEMENT:
+        switch (f.step) {
+          case 0:
+            if (!parse_symbol(SymbolKind::ELSE)) {
+              fail();
+            } else if (current_symbol() == SymbolKind::IF) {
+              f.step = 1;
+              call(Rule::IF_STATEMENT);
+            } else {
+              f.step = 2;
+              call(Rule::COMPOUND_STATEMENT);
+            }
+            break;
+          case 1:
+            succeeded_ ? succeed(std::move(result_)) : fail();
+            break;
+          default:
+            if (succeeded_) {
+              succeed(arena_->make<ast::ElseStatementData>(
+                  take<ast::CompoundStatement>(std::move(result_))));
+            } else {
+              fail();
+            }
+            break;
+        }
+        break;
+      case Rule::WHILE_STATEMENT:
+        switch (f.step++) {
+          case 0:
+            if (parse_symbol(SymbolKind::WHILE) &&
+                parse_symbol(SymbolKind::LEFT_PAREN)) {
+              call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+            } else {
+              fail();
+            }
+            break;
+          case 1:
+            if (succeeded_ && parse_symbol(SymbolKind::RIGHT_PAREN)) {
+              f.nodes[0] = std::move(result_);
+              call(Rule::COMPOUND_STATEMENT);
+            } else {
+              fail();
+            }
+            break;
+          default:
+            if (succeeded_) {
+              succeed(arena_->make<ast::WhileStatementData>(
+                  take<ast::Expression>(std::move(f.nodes[0])),
+                  take<ast::CompoundStatement>(std::move(result_))));
+            } else {
+              fail();
+            }
+            break;
+        }
+        break;
+      case Rule::FOR_STATEMENT:
+        // 三つの式はどれも省略できる。
+        switch (f.step++) {
+          case 0:
+            if (parse_symbol(SymbolKind::FOR) &&
+                parse_symbol(SymbolKind::LEFT_PAREN)) {
+              call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+            } else {
+              fail();
+            }
+            break;
+          case 1:
+          case 2:
+            if (succeeded_) f.nodes[f.step - 2] = std::move(result_);
+            if (parse_symbol(SymbolKind::SEMICOLON)) {
+              call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+            } else {
+              fail();
+            }
+            break;
+          case 3:
+            if (succeeded_) f.nodes[2] = std::move(result_);
+            if (parse_symbol(SymbolKind::RIGHT_PAREN)) {
+              call(Rule::COMPOUND_STATEMENT);
+            } else {
+              fail();
+            }
+            break;
+          default:
+            if (succeeded_) {
+              succeed(arena_->make<ast::ForStatementData>(
+                  take<ast::Expression>(std::move(f.nodes[0])),
+                  take<ast::Expression>(std::move(f.nodes[1])),
+                  take<ast::Expression>(std::move(f.nodes[2])),
+                  take<ast::CompoundStatement>(std::move(result_))));
+            } else {
+              fail();
+            }
+            break;
+        }
+        break;
+      case Rule::RETURN_STATEMENT:
+        if (f.step++ == 0) {
+          if (parse_symbol(SymbolKind::RETURN)) {
+            call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+          } else {
+            fail();
+          }
+        } else if (succeeded_ && parse_symbol(SymbolKind::SEMICOLON)) {
+          succeed(arena_->make<ast::ReturnStatementData>(
+              take<ast::Expression>(std::move(result_))));
+        } else {
+          fail();
+        }
+        break;
+      case Rule::VARIABLE_DEFINITION_STATEMENT:
+        if (f.step++ == 0) {
+          call(Rule::VARIABLE_DEFINITION);
+        } else if (succeeded_ && parse_symbol(SymbolKind::SEMICOLON)) {
+          succeed(arena_->make<ast::VariableDefinitionStatementData>(
+              take<ast::VariableDefinition>(std::move(result_))));
+        } else {
+          fail();
+        }
+        break;
+      case Rule::VARIABLE_DEFINITION:
+        if (f.step++ == 0) {
+          if (parse_symbol(SymbolKind::DEF)) {
+            if (auto type_name = parse_type()) {
+              f.is_mutable = parse_symbol(SymbolKind::VAR);
+              if (auto variable_name = parse_identifier()) {
+                if (parse_symbol(SymbolKind::ASSIGN)) {
+                  f.nodes[0] = std::move(*type_name);
+                  f.nodes[1] = std::move(*variable_name);
+                  call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+                  break;
+                }
+              }
+            }
+          }
+          fail();
+        } else if (succeeded_) {
+          succeed(arena_->make<ast::VariableDefinitionData>(
+              take<ast::Type>(std::move(f.nodes[0])),
+              f.is_mutable,
+              take<ast::Identifier>(std::move(f.nodes[1])),
+              take<ast::Expression>(std::move(result_))));
+        } else {
+          fail();
+        }
+        break;
+      case Rule::EXPRESSION_STATEMENT:
+        if (f.step++ == 0) {
+          call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+        } else if (parse_symbol(SymbolKind::SEMICOLON)) {
+          succeed(arena_->make<ast::ExpressionStatementData>(
+              succeeded_ ? take<ast::Expression>(std::move(result_))
+                         : nullptr));
+        } else {
+          fail();
+        }
+        break;
+      case Rule::EXPRESSION:
+      case Rule::BINARY_EXPRESSION:
+        // parse_binary_expression の一回の呼び出しに当たる。step 1 は
+        // 左辺を、step 2 は右辺を読んだところ、step 3 は左辺を積んだ側が
+        // 渡したところ。
+        if (f.step == 0) {
+          if (auto operand = parse_simple_operand()) {
+            f.nodes[0] = std::move(operand);
+          } else if (starts_compound_operand()) {
+            f.step = 1;
+            call(Rule::UNARY_EXPRESSION);
+            break;
+          } else {
+            expect(OPERAND_FIRST);
+            fail();
+            break;
+          }
+        } else if (f.step == 1) {
+          if (!succeeded_) {
+            fail();
+            break;
+          }
+          f.nodes[0] = std::move(result_);
+        } else if (f.step == 2) {
+          if (!succeeded_) {
+            tokens_.seek(f.position);
+            succeed(std::move(f.nodes[0]));
+            break;
+          }
+          fold(f, std::move(result_));
+        }
+        f.step = 2;
+        // 右辺は一つ高い優先順位から読む。右辺が単純な被演算子で、後に
+        // それより強い演算子が続かなければ、積まずにその場で畳む。
+        while (true) {
+          const auto& op = binary_operator(current_symbol());
+          if (op.precedence < f.precedence ||
+              f.max_precedence <= op.precedence) {
+            if (op.precedence == NO_PRECEDENCE) expect(BINARY_OPERATORS);
+            succeed(std::move(f.nodes[0]));
+            break;
+          }
+          f.symbol = current_symbol();
+          f.position = tokens_.position();
+          advance(1);
+          auto operand = parse_simple_operand();
+          if (!operand) {
+            if (starts_compound_operand()) {
+              call(Rule::BINARY_EXPRESSION, op.precedence + 1);
+            } else {
+              expect(OPERAND_FIRST);
+              tokens_.seek(f.position);
+              succeed(std::move(f.nodes[0]));
+            }
+            break;
+          }
+          if (binary_operator(current_symbol()).precedence > op.precedence) {
+            call(Rule::BINARY_EXPRESSION, op.precedence + 1);
+            stack_.back().nodes[0] = std::move(operand);
+            stack_.back().step = 3;
+            break;
+          }
+          fold(f, std::move(operand));
+        }
+        break;
+      case Rule::UNARY_EXPRESSION:
+        if (f.step++ == 0) {
+          while (current_symbol() == SymbolKind::NOT ||
+                 current_symbol() == SymbolKind::TILDE) {
+            advance(1);
+          }
+          f.position = tokens_.position();
+          // 括弧で始まる後置式は一次式でしかありえない。
+          if (current_symbol() == SymbolKind::LEFT_PAREN) {
+            call(Rule::PRIMARY_EXPRESSION);
+          } else {
+            call(Rule::POSTFIX_EXPRESSION);
+          }
+        } else if (succeeded_) {
+          auto expression = take<ast::UnaryExpression>(std::move(result_));
+          for (std::size_t i = f.position; i != f.start.position(); ) {
+            --i;
+            if (tokens_[i].symbol() == SymbolKind::NOT) {
+              expression = arena_->make<ast::NotExpressionData>(
+                  std::move(expression));
+            } else {
+              expression = arena_->make<ast::MinusExpressionData>(
+                  std::move(expression));
+            }
+          }
+          succeed(std::move(expression));
+        } else {
+          expect(OPERAND_FIRST);
+          fail();
+        }
+        break;
+      case Rule::POSTFIX_EXPRESSION:
+        switch (f.step++) {
+          case 0:
+            // 関数呼び出しは識別子で始まる。
+            if (current_type() == TokenType::IDENTIFIER) {
+              call(Rule::FUNCTION_CALL_EXPRESSION);
+            } else {
+              expect(ParseError::IDENTIFIER);
+              f.step = 2;
+              call(Rule::PRIMARY_EXPRESSION);
+            }
+            break;
+          case 1:
+            if (succeeded_) {
+              succeed(std::move(result_));
+            } else {
+              call(Rule::PRIMARY_EXPRESSION);
+            }
+            break;
+          default:
+            succeeded_ ? succeed(std::move(result_)) : fail();
+            break;
+        }
+        break;
+      case Rule::FUNCTION_CALL_EXPRESSION:
+        // step 1 は最初の引数、step 2 はコンマの後の引数を読んだところ。
+        if (f.step == 0) {
+          if (auto function_name = parse_identifier()) {
+            if (parse_symbol(SymbolKind::LEFT_PAREN) && enter_nesting()) {
+              f.nodes[0] = std::move(*function_name);
+              f.step = 1;
+              call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+              break;
+            }
+          }
+          fail();
+          break;
+        }
+        if (succeeded_) {
+          items_.push_back(arena_->make<ast::ParameterData>(
+              take<ast::Expression>(std::move(result_))));
+          f.position = tokens_.position();
+          if (parse_symbol(SymbolKind::COMMA)) {
+            f.step = 2;
+            call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+            break;
+          }
+        } else if (f.step == 2) {
+          tokens_.seek(f.position);
+        }
+        {
+          auto parameters = take_items<ast::Parameter>(items_, f.base);
+          auto parameter_list = arena_->make<ast::ParameterListData>(
+              arena_->make_array(parameters));
+          if (parse_symbol(SymbolKind::RIGHT_PAREN)) {
+            succeed(arena_->make<ast::FunctionCallExpressionData>(
+                take<ast::Identifier>(std::move(f.nodes[0])),
+                std::move(parameter_list)));
+          } else {
+            fail();
+          }
+        }
+        break;
+      case Rule::PRIMARY_EXPRESSION:
+        if (f.step++ == 0) {
+          if (parse_symbol(SymbolKind::LEFT_PAREN)) {
+            if (enter_nesting()) {
+              call(Rule::EXPRESSION, ASSIGN_PRECEDENCE);
+            } else {
+              fail();
+            }
+          } else if (auto primary_expression = parse_primary_leaf()) {
+            succeed(std::move(*primary_expression));
+          } else {
+            fail();
+          }
+        } else if (succeeded_ && parse_symbol(SymbolKind::RIGHT_PAREN)) {
+          succeed(arena_->make<ast::ParenthesizedExpressionData>(
+              take<ast::Expression>(std::move(result_))));
+        } else {
+          fail();
+        }
+        break;
+      default:
+        fail();
+        break;
+    }
+  }
+  return succeeded_ ? std::move(result_) : nullptr;
+}
+
+void Parser::call_statement() {
+  // 先頭のトークンで規則が一つに決まる。
+  switch (current_symbol()) {
+    case SymbolKind::LEFT_BRACE:
+      call(Rule::COMPOUND_STATEMENT);
+      break;
+    case SymbolKind::IF:
+      call(Rule::IF_STATEMENT);
+      break;
+    case SymbolKind::WHILE:
+      call(Rule::WHILE_STATEMENT);
+      break;
+    case SymbolKind::FOR:
+      call(Rule::FOR_STATEMENT);
+      break;
+    case SymbolKind::RETURN:
+      call(Rule::RETURN_STATEMENT);
+      break;
+    case SymbolKind::BREAK:
+      result_ = parse_break_statement().value_or(nullptr);
+      succeeded_ = result_ != nullptr;
+      break;
+    case SymbolKind::CONTINUE:
+      result_ = parse_continue_statement().value_or(nullptr);
+      succeeded_ = result_ != nullptr;
+      break;
+    case SymbolKind::DEF:
+      call(Rule::VARIABLE_DEFINITION_STATEMENT);
+      break;
+    default:
+      call(Rule::EXPRESSION_STATEMENT);
+      break;
+  }
+}
+
+void Parser::fold(Frame& f, ast::BasePtr rhs) {
+  const auto& op = binary_operator(f.symbol);
+  f.nodes[0] = op.make(*arena_, take<ast::Expression>(std::move(f.nodes[0])),
+                       take<ast::Expression>(std::move(rhs)));
+  f.max_precedence =
+      op.left_associative ? op.precedence + 1 : op.precedence;
+}
+
+void Parser::call(Rule rule, int precedence) {
+  if (rule != Rule::BINARY_EXPRESSION && known_failure(rule)) {
+    succeeded_ = false;
+    return;
+  }
+  stack_.emplace_back(rule, snapshot(), precedence, items_.size());
+}
+
+void Parser::succeed(ast::BasePtr node) {
+  if (stack_.back().nested) {
+    --depth_;
+  }
+  stack_.pop_back();
+  succeeded_ = true;
+  result_ = std::move(node);
+}
+
+void Parser::fail() {
+  Frame& f = stack_.back();
+  rewind(f.start);
+  items_.resize(f.base);
+  if (f.nested) {
+    --depth_;
+  }
+  const Rule rule = f.rule;
+  stack_.pop_back();
+  if (rule != Rule::BINARY_EXPRESSION) {
+    record_failure(rule);
+  }
+  succeeded_ = false;
+}
+
+bool Parser::enter_nesting() {
+  if (depth_ == nesting_limit_) {
+    nesting_limit_exceeded_ = true;
+    return false;
+  }
+  ++depth_;
+  stack_.back().nested = true;
+  return true;
+}
+
+TokenType Parser::current_type() {
+  Token const* const token = tokens_.peek();
+  return token ? token->type() : TokenType::IGNORE;
+}
+
+SymbolKind Parser::current_symbol() {
+  Token const* const token = tokens_.peek();
+  return token ? token->symbol() : SymbolKind::NONE;
+}
+
+StringRef Parser::current_string() {
+  Token const* const token = tokens_.peek();
+  return token ? tokens_.str(*token) : StringRef();
+}
+
+bool Parser::is_eof() {
+  return tokens_.peek() == nullptr;
 }
 
 bool Parser::advance(int count) {
-  using std::begin;
-  using std::end;
-  const auto b = begin(tokens_);
-  const auto e = end(tokens_);
   while (count < 0) {
-    if (current_ != b) {
+    if (tokens_.position() != 0) {
       ++count;
-      --current_;
+      tokens_.seek(tokens_.position() - 1);
     } else {
       return false;
     }
   }
   while (0 < count) {
-    if (current_ != e) {
+    if (!is_eof()) {
       --count;
-      ++current_;
+      tokens_.advance();
     } else {
       return false;
     }
@@ -624,12 +1532,122 @@ bool Parser::advance(int count) {
   return true;
 }
 
-auto Parser::snapshot() const -> Pointer {
-  return current_;
+bool Parser::known_failure(Rule rule) const {
+  if (failures_.empty()) return false;
+  const auto index = tokens_.position();
+  return (failures_[index] >> static_cast<int>(rule)) & 1;
+}
+
+Left<ParseError> Parser::record_failure(Rule rule) {
+  if (!failures_.empty()) {
+    const auto index = tokens_.position();
+    failures_[index] |= std::uint32_t{1} << static_cast<int>(rule);
+    failures_begin_ = std::min(failures_begin_, index);
+    failures_end_ = std::max(failures_end_, index + 1);
+  }
+  return error();
+}
+
+// 最も先の位置で読めたはずのものだけを集める。どちらの読み方でも同じ位置で
+// 同じものを試すので、集合は読み方によらない。メモ化した失敗はここを
+// 通らずに返るが、覚えるのは最後に読み飛ばしてからの失敗だけなので
+// (report を参照)、その分はすでに集めてある。
+void Parser::expect(std::uint64_t what) {
+  const std::size_t position = tokens_.position();
+  if (farthest_ < position) {
+    farthest_ = position;
+    expected_ = what;
+  } else if (farthest_ == position) {
+    expected_ |= what;
+  }
+}
+
+Left<ParseError> Parser::error() const {
+  return make_left(ParseError{farthest_, expected_});
+}
+
+template <typename T>
+ParseResult<T> Parser::result(ast::BasePtr node) const {
+  if (node) {
+    return make_right(take<T>(std::move(node)));
+  }
+  return error();
+}
+
+auto Parser::snapshot() -> Pointer {
+  return tokens_.mark();
+}
+
+void Parser::rewind(Pointer const& p) {
+  tokens_.reset(p);
+}
+
+bool Parser::at_function_definition() {
+  // 変数定義は def の次が型なので、識別子が続けば関数定義。
+  if (current_symbol() != SymbolKind::DEF) return false;
+  const auto s = snapshot();
+  advance(1);
+  const bool ret = current_type() == TokenType::IDENTIFIER;
+  tokens_.reset(s);
+  return ret;
 }
 
-void Parser::rewind(Pointer p) {
-  current_ = p;
+// 読めなかった文を、同じ深さの ';' の後か '}' の前まで読み飛ばす。
+// 途中で関数定義が始まるか列が終われば、何もせずに偽を返して、この文を
+// 含む関数定義ごと読み飛ばさせる。
+bool Parser::recover_statement() {
+  const auto s = snapshot();
+  int depth = 0;
+  while (!is_eof() && !at_function_definition()) {
+    const SymbolKind symbol = current_symbol();
+    if (symbol == SymbolKind::RIGHT_BRACE && depth == 0) {
+      break;
+    }
+    advance(1);
+    if (symbol == SymbolKind::LEFT_BRACE) {
+      ++depth;
+    } else if (symbol == SymbolKind::RIGHT_BRACE) {
+      --depth;
+    } else if (symbol == SymbolKind::SEMICOLON && depth == 0) {
+      break;
+    }
+  }
+  if (is_eof() || at_function_definition()) {
+    tokens_.reset(s);
+    return false;
+  }
+  report(s.position());
+  return true;
+}
+
+void Parser::recover_function_definition() {
+  const std::size_t begin = tokens_.position();
+  advance(1);
+  while (!is_eof() && !at_function_definition()) {
+    advance(1);
+  }
+  report(begin);
+}
+
+// begin から今の位置までを読み飛ばしたことを記録し、その先で読めなかった
+// ものを集め直す。覚えた失敗は、失敗した位置と読めたはずのものを
+// farthest_ と expected_ に入れ直さずに返るので、ここで忘れる。残すと、
+// メモ化したときだけ誤りの位置と集合が変わる。
+void Parser::report(std::size_t begin) {
+  if (farthest_ < begin) {
+    farthest_ = begin;
+    expected_ = 0;
+  }
+  diagnostics_.push_back(
+      Diagnostic{farthest_, expected_, begin, tokens_.position()});
+  farthest_ = tokens_.position();
+  expected_ = 0;
+  if (failures_begin_ < failures_end_) {
+    std::fill(failures_.begin() + failures_begin_,
+              failures_.begin() + failures_end_, 0);
+    failures_begin_ = failures_.size();
+    failures_end_ = 0;
+  }
 }
 
 }  // namespace klang
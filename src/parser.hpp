@@ -1,59 +1,205 @@
 #ifndef KMC_KLANG_PARSER_HPP
 #define KMC_KLANG_PARSER_HPP
 
+#include "arena.hpp"
 #include "ast.hpp"
+#include "either.hpp"
 #include "lexer.hpp"
 
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
 namespace klang {
 
+// 読めなかった理由。規則を試して読めなかった最も先のトークンの位置と、
+// そこで読めたはずのものの集合を持つ。
+struct ParseError {
+  // expected のビット。SymbolKind の値 k は 1 << k で表す。
+  enum Expected : std::uint64_t {
+    IDENTIFIER = std::uint64_t{1} << 48,
+    NUMBER = std::uint64_t{1} << 49,
+    CHARACTER = std::uint64_t{1} << 50,
+    STRING = std::uint64_t{1} << 51,
+    TYPE = std::uint64_t{1} << 52
+  };
+  static constexpr std::uint64_t symbol(SymbolKind kind) {
+    return std::uint64_t{1} << static_cast<int>(kind);
+  }
+  std::size_t position;  // トークン列の添字。末尾なら列の長さ
+  std::uint64_t expected;
+};
+static_assert(static_cast<int>(SymbolKind::COMMA) < 48,
+              "SymbolKind must fit below ParseError::IDENTIFIER");
+
+// 読めればノードを右に、読めなければ ParseError を左に持つ。
+template <typename T>
+using ParseResult = Either<ParseError, ast::NodePtr<T>>;
+
+// 構文エラー一つ分。位置はどれもトークン列の添字。
+struct Diagnostic {
+  std::size_t position;    // 読めなかった最も先のトークン。末尾なら列の長さ
+  std::uint64_t expected;  // そこで読めたはずのもの。ParseError と同じ
+  std::size_t begin;       // 読み飛ばしたトークンの範囲
+  std::size_t end;
+};
+
 class Parser {
  public:
-  Parser(TokenVector tokens);
-  bool parse_symbol(const char* str);
-  ast::IdentifierPtr parse_identifier();
-  ast::TypePtr parse_type();
-  ast::IntegerLiteralPtr parse_integer_literal();
-  ast::CharacterLiteralPtr parse_character_literal();
-  ast::StringLiteralPtr parse_string_literal();
+  // memoize が真なら、(規則, トークン位置) ごとに失敗を覚えておき、
+  // 同じ位置で同じ規則を試し直さない。
+  // 作ったノードは Parser の Arena に置かれるので、翻訳単位以外の
+  // ノードは Parser か、それが返した翻訳単位が生きている間だけ有効。
+  Parser(TokenVector tokens, bool memoize = false);
+  // トークンを必要な分だけ字句解析しながら読む。関数定義を読み終えるたびに
+  // それまでのトークンを捨てる。memoize はできない。
+  explicit Parser(TokenStream tokens);
+  // 文と式を、再帰ではなくヒープ上のスタックで読む。入れ子がどれだけ深くても
+  // ネイティブのスタックは一定しか使わない。括弧と波括弧の入れ子が
+  // nesting_limit を超えたら、そこで読むのをやめる。
+  void use_explicit_stack(std::size_t nesting_limit = 1 << 16);
+  // 入れ子が深すぎて読むのをやめたか。
+  bool nesting_limit_exceeded() const { return nesting_limit_exceeded_; }
+  // 読めない文を ';' の後か '}' の前まで、読めない関数定義を次の関数定義の
+  // def まで読み飛ばして続きを読み、一度で全ての構文エラーを集める。
+  // 読み飛ばした文は構文木に入らない。
+  void recover_from_errors();
+  std::vector<Diagnostic> const& diagnostics() const { return diagnostics_; }
+  bool parse_symbol(SymbolKind symbol);
+  ParseResult<ast::Identifier> parse_identifier();
+  ParseResult<ast::Type> parse_type();
+  ParseResult<ast::IntegerLiteral> parse_integer_literal();
+  ParseResult<ast::CharacterLiteral> parse_character_literal();
+  ParseResult<ast::StringLiteral> parse_string_literal();
   ast::TranslationUnitPtr parse_translation_unit();
-  ast::FunctionDefinitionPtr parse_function_definition();
-  ast::ArgumentListPtr parse_argument_list();
-  ast::ArgumentPtr parse_argument();
-  ast::StatementPtr parse_statement();
-  ast::CompoundStatementPtr parse_compound_statement();
-  ast::IfStatementPtr parse_if_statement();
-  ast::ElseStatementPtr parse_else_statement();
-  ast::WhileStatementPtr parse_while_statement();
-  ast::ForStatementPtr parse_for_statement();
-  ast::ReturnStatementPtr parse_return_statement();
-  ast::BreakStatementPtr parse_break_statement();
-  ast::ContinueStatementPtr parse_continue_statement();
-  ast::VariableDefinitionStatementPtr parse_variable_definition_statement();
-  ast::VariableDefinitionPtr parse_variable_definition();
-  ast::ExpressionStatementPtr parse_expression_statement();
-  ast::ExpressionPtr parse_expression();
-  ast::AssignExpressionPtr parse_assign_expression();
-  ast::OrExpressionPtr parse_or_expression();
-  ast::AndExpressionPtr parse_and_expression();
-  ast::ComparativeExpressionPtr parse_comparative_expression();
-  ast::AdditiveExpressionPtr parse_additive_expression();
-  ast::MultiplicativeExpressionPtr parse_multiplicative_expression();
-  ast::UnaryExpressionPtr parse_unary_expression();
-  ast::PostfixExpressionPtr parse_postfix_expression();
-  ast::FunctionCallExpressionPtr parse_function_call_expression();
-  ast::ParameterListPtr parse_parameter_list();
-  ast::ParameterPtr parse_parameter();
-  ast::PrimaryExpressionPtr parse_primary_expression();
+  // 波括弧の深さが 0 の def で区切り、関数定義を jobs 個のスレッドで読む。
+  // jobs が 0 ならハードウェアのスレッド数を使う。結果は逐次版と同じ。
+  // TokenStream から作ったときは逐次版で読む。
+  ast::TranslationUnitPtr parse_translation_unit_in_parallel(
+      unsigned jobs = 0);
+  // old は old_tokens を読んだ翻訳単位で、old_tokens のソースに edit を
+  // 施したものを字句解析した結果がこの Parser のトークン列とする。
+  // edit に触れる関数定義だけを読み直し、残りは old から引き取る。
+  // old の Arena の中身はこの Parser の Arena に移る。結果は
+  // parse_translation_unit と同じ。
+  ast::TranslationUnitPtr reparse_translation_unit(
+      ast::TranslationUnitPtr old, TokenVector const& old_tokens,
+      Edit const& edit);
+  ParseResult<ast::FunctionDefinition> parse_function_definition();
+  ParseResult<ast::ArgumentList> parse_argument_list();
+  ParseResult<ast::Argument> parse_argument();
+  ParseResult<ast::Statement> parse_statement();
+  ParseResult<ast::CompoundStatement> parse_compound_statement();
+  ParseResult<ast::IfStatement> parse_if_statement();
+  ParseResult<ast::ElseStatement> parse_else_statement();
+  ParseResult<ast::WhileStatement> parse_while_statement();
+  ParseResult<ast::ForStatement> parse_for_statement();
+  ParseResult<ast::ReturnStatement> parse_return_statement();
+  ParseResult<ast::BreakStatement> parse_break_statement();
+  ParseResult<ast::ContinueStatement> parse_continue_statement();
+  ParseResult<ast::VariableDefinitionStatement>
+  parse_variable_definition_statement();
+  ParseResult<ast::VariableDefinition> parse_variable_definition();
+  ParseResult<ast::ExpressionStatement> parse_expression_statement();
+  ParseResult<ast::Expression> parse_expression();
+  ParseResult<ast::UnaryExpression> parse_unary_expression();
+  ParseResult<ast::PostfixExpression> parse_postfix_expression();
+  ParseResult<ast::FunctionCallExpression> parse_function_call_expression();
+  ParseResult<ast::ParameterList> parse_parameter_list();
+  ParseResult<ast::Parameter> parse_parameter();
+  ParseResult<ast::PrimaryExpression> parse_primary_expression();
  private:
-  using Pointer = TokenVector::const_iterator;
-  TokenType current_type() const;
-  std::string current_string() const;
-  bool is_eof() const;
+  enum class Rule {
+    FUNCTION_DEFINITION,
+    ARGUMENT,
+    STATEMENT,
+    COMPOUND_STATEMENT,
+    IF_STATEMENT,
+    ELSE_STATEMENT,
+    WHILE_STATEMENT,
+    FOR_STATEMENT,
+    RETURN_STATEMENT,
+    BREAK_STATEMENT,
+    CONTINUE_STATEMENT,
+    VARIABLE_DEFINITION_STATEMENT,
+    VARIABLE_DEFINITION,
+    EXPRESSION_STATEMENT,
+    EXPRESSION,
+    UNARY_EXPRESSION,
+    POSTFIX_EXPRESSION,
+    FUNCTION_CALL_EXPRESSION,
+    PRIMARY_EXPRESSION,
+    BINARY_EXPRESSION  // 明示的なスタックでだけ使い、失敗は覚えない
+  };
+  using Pointer = TokenStream::Mark;
+  // 明示的なスタックで読みかけの規則一つ分の状態。
+  struct Frame {
+    Frame(Rule rule, Pointer start, int precedence, std::size_t base);
+    Rule rule;
+    int step;
+    int precedence;      // 二項演算子をこれ以上の優先順位だけ読む
+    int max_precedence;  // 演算子を畳んだ後は、これ未満だけ読む
+    bool nested;         // 括弧か波括弧の内側に入ったか
+    bool is_mutable;
+    SymbolKind symbol;   // 読みかけの二項演算子
+    Pointer start;
+    std::size_t base;      // items_ のうち、この規則が積んだ分の先頭
+    std::size_t position;  // 読み戻す位置か、前置演算子の終わり
+    ast::BasePtr nodes[3];
+  };
+  ast::BasePtr run(Rule rule, int precedence = 0);
+  void call(Rule rule, int precedence = 0);
+  void call_statement();
+  void fold(Frame& f, ast::BasePtr rhs);
+  void succeed(ast::BasePtr node);
+  void fail();
+  bool enter_nesting();
+  // 括弧で始まらない一次式。
+  ParseResult<ast::PrimaryExpression> parse_primary_leaf();
+  // 前置演算子も括弧も関数呼び出しも含まない被演算子なら読む。
+  // そうでなければ何も読まずに nullptr を返す。
+  ast::PrimaryExpressionPtr parse_simple_operand();
+  // parse_simple_operand が読めなかったとき、被演算子が始まりうるか。
+  bool starts_compound_operand();
+  bool at_function_definition();
+  bool recover_statement();
+  void recover_function_definition();
+  void report(std::size_t begin);
+  // 二項演算子を優先順位法で読む。min_precedence 未満の演算子は読まない。
+  ParseResult<ast::Expression> parse_binary_expression(int min_precedence);
+  TokenType current_type();
+  SymbolKind current_symbol();
+  StringRef current_string();
+  bool is_eof();
   bool advance(int count);
-  Pointer snapshot() const;
-  void rewind(Pointer p);
-  const TokenVector tokens_;
-  Pointer current_;
+  Pointer snapshot();
+  void rewind(Pointer const& p);
+  bool known_failure(Rule rule) const;
+  Left<ParseError> record_failure(Rule rule);
+  // 今の位置で what のどれかを読もうとして読めなかったことを覚える。
+  void expect(std::uint64_t what);
+  Left<ParseError> error() const;
+  template <typename T>
+  ParseResult<T> result(ast::BasePtr node) const;
+  TokenStream tokens_;
+  std::vector<std::uint32_t> failures_;
+  // 最後に読み飛ばしてから失敗を覚えた位置の範囲。この外はすべて 0。
+  std::size_t failures_begin_;
+  std::size_t failures_end_;
+  ast::ArenaPtr arena_;
+  std::uint32_t function_offset_;  // 読んでいる関数定義の先頭の位置
+  bool explicit_stack_;
+  bool nesting_limit_exceeded_;
+  std::size_t nesting_limit_;
+  std::size_t depth_;
+  std::vector<Frame> stack_;
+  std::vector<ast::BasePtr> items_;  // 複合文の文と関数呼び出しの引数
+  bool succeeded_;                   // 最後に終えた規則の結果
+  ast::BasePtr result_;
+  bool recover_;
+  std::size_t farthest_;  // 最後に読み飛ばしてから、読めなかった最も先の位置
+  std::uint64_t expected_;  // farthest_ で読めたはずのもの
+  std::vector<Diagnostic> diagnostics_;
 };
 
 }  // namespace klang
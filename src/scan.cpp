@@ -0,0 +1,183 @@
+#include "scan.hpp"
+
+#include <cstring>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define KLANG_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace klang {
+namespace scan {
+
+namespace {
+
+bool space(char c) {
+  return c == ' ' || static_cast<unsigned char>(c - '\t') <= '\r' - '\t';
+}
+
+const char* find_scalar(const char* first, const char* last, char c) {
+  auto const found = std::memchr(first, c, last - first);
+  return found ? static_cast<const char*>(found) : last;
+}
+
+const char* find_either_scalar(const char* first, const char* last,
+                               char a, char b) {
+  for (; first != last; ++first) {
+    if (*first == a || *first == b) break;
+  }
+  return first;
+}
+
+const char* skip_spaces_scalar(const char* first, const char* last) {
+  while (first != last && space(*first)) ++first;
+  return first;
+}
+
+#ifdef KLANG_SCAN_X86
+
+// 各実装は幅 W のブロックごとに一致したバイトのビットマスクを作り、
+// 最下位の 1 の位置を返す。端数は 1 バイトずつ調べる。
+
+// SSE2 は x86-64 で必ず使える。
+const char* find_sse2(const char* first, const char* last, char c) {
+  const __m128i needle = _mm_set1_epi8(c);
+  for (; last - first >= 16; first += 16) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    const int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (mask != 0) return first + __builtin_ctz(mask);
+  }
+  return find_either_scalar(first, last, c, c);
+}
+
+const char* find_either_sse2(const char* first, const char* last,
+                             char a, char b) {
+  const __m128i needle_a = _mm_set1_epi8(a);
+  const __m128i needle_b = _mm_set1_epi8(b);
+  for (; last - first >= 16; first += 16) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    const int mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(block, needle_a),
+                     _mm_cmpeq_epi8(block, needle_b)));
+    if (mask != 0) return first + __builtin_ctz(mask);
+  }
+  return find_either_scalar(first, last, a, b);
+}
+
+// '\t' から '\r' は、'\t' を引いて符号なしで 4 以下かどうかで判定する。
+const char* skip_spaces_sse2(const char* first, const char* last) {
+  const __m128i blank = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i range = _mm_set1_epi8('\r' - '\t');
+  for (; last - first >= 16; first += 16) {
+    const __m128i block =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+    const __m128i shifted = _mm_sub_epi8(block, tab);
+    const __m128i control =
+        _mm_cmpeq_epi8(_mm_min_epu8(shifted, range), shifted);
+    const int mask = _mm_movemask_epi8(
+        _mm_or_si128(_mm_cmpeq_epi8(block, blank), control));
+    if (mask != 0xffff) return first + __builtin_ctz(~mask);
+  }
+  return skip_spaces_scalar(first, last);
+}
+
+__attribute__((target("avx2")))
+const char* find_avx2(const char* first, const char* last, char c) {
+  const __m256i needle = _mm256_set1_epi8(c);
+  for (; last - first >= 32; first += 32) {
+    const __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    const unsigned mask = static_cast<unsigned>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+    if (mask != 0) return first + __builtin_ctz(mask);
+  }
+  return find_sse2(first, last, c);
+}
+
+__attribute__((target("avx2")))
+const char* find_either_avx2(const char* first, const char* last,
+                             char a, char b) {
+  const __m256i needle_a = _mm256_set1_epi8(a);
+  const __m256i needle_b = _mm256_set1_epi8(b);
+  for (; last - first >= 32; first += 32) {
+    const __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(block, needle_a),
+                        _mm256_cmpeq_epi8(block, needle_b))));
+    if (mask != 0) return first + __builtin_ctz(mask);
+  }
+  return find_either_sse2(first, last, a, b);
+}
+
+__attribute__((target("avx2")))
+const char* skip_spaces_avx2(const char* first, const char* last) {
+  const __m256i blank = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i range = _mm256_set1_epi8('\r' - '\t');
+  for (; last - first >= 32; first += 32) {
+    const __m256i block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+    const __m256i shifted = _mm256_sub_epi8(block, tab);
+    const __m256i control =
+        _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, range), shifted);
+    const unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(
+        _mm256_or_si256(_mm256_cmpeq_epi8(block, blank), control)));
+    if (mask != 0xffffffffu) return first + __builtin_ctz(~mask);
+  }
+  return skip_spaces_sse2(first, last);
+}
+
+#endif  // KLANG_SCAN_X86
+
+const Scanner scalar_scanner = {
+  find_scalar, find_either_scalar, skip_spaces_scalar
+};
+#ifdef KLANG_SCAN_X86
+const Scanner sse2_scanner = {
+  find_sse2, find_either_sse2, skip_spaces_sse2
+};
+const Scanner avx2_scanner = {
+  find_avx2, find_either_avx2, skip_spaces_avx2
+};
+#endif
+
+}  // unnamed namespace
+
+bool supported(Isa isa) {
+  switch (isa) {
+    case Isa::SCALAR:
+      return true;
+#ifdef KLANG_SCAN_X86
+    case Isa::SSE2:
+      return true;
+    case Isa::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+Scanner const& scanner(Isa isa) {
+  switch (isa) {
+#ifdef KLANG_SCAN_X86
+    case Isa::SSE2: return sse2_scanner;
+    case Isa::AVX2: return avx2_scanner;
+#endif
+    default: return scalar_scanner;
+  }
+}
+
+Scanner const& scanner() {
+  static Scanner const& best = scanner(
+      supported(Isa::AVX2) ? Isa::AVX2 :
+      supported(Isa::SSE2) ? Isa::SSE2 : Isa::SCALAR);
+  return best;
+}
+
+}  // namespace scan
+}  // namespace klang
@@ -0,0 +1,31 @@
+#ifndef KMC_KLANG_SCAN_HPP
+#define KMC_KLANG_SCAN_HPP
+
+namespace klang {
+namespace scan {
+
+// 字句解析器が長い区間を読み飛ばすための関数。どれも [first, last) を
+// 調べ、見つからなければ last を返す。
+struct Scanner {
+  // 最初の c の位置。
+  const char* (*find)(const char* first, const char* last, char c);
+  // 最初の a か b の位置。
+  const char* (*find_either)(const char* first, const char* last,
+                             char a, char b);
+  // 最初の空白 (' ' と '\t' から '\r') でない文字の位置。
+  const char* (*skip_spaces)(const char* first, const char* last);
+};
+
+enum class Isa { SCALAR, SSE2, AVX2 };
+
+// この CPU で isa の命令が使えるか。SCALAR はいつでも使える。
+bool supported(Isa isa);
+// isa を使う実装。supported(isa) のときだけ呼ぶ。
+Scanner const& scanner(Isa isa);
+// 使える中で最も速い実装。最初の呼び出しで CPU を調べて決める。
+Scanner const& scanner();
+
+}  // namespace scan
+}  // namespace klang
+
+#endif  // KMC_KLANG_SCAN_HPP
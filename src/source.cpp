@@ -0,0 +1,109 @@
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "source.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(HAVE_MMAP) && defined(HAVE_MUNMAP)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define KMC_KLANG_USE_MMAP 1
+#endif
+
+namespace klang {
+
+SourceBuffer::SourceBuffer()
+    : storage_(), data_(nullptr), size_(0), mapped_(nullptr)
+{}
+
+SourceBuffer::SourceBuffer(std::string str)
+    : storage_(std::move(str)),
+      data_(storage_.data()),
+      size_(storage_.size()),
+      mapped_(nullptr)
+{}
+
+SourceBuffer::~SourceBuffer() {
+#ifdef KMC_KLANG_USE_MMAP
+  if (mapped_) {
+    ::munmap(mapped_, size_);
+  }
+#endif
+}
+
+SourceBufferPtr SourceBuffer::map_file(const std::string& path) {
+#ifdef KMC_KLANG_USE_MMAP
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    return nullptr;
+  }
+  std::shared_ptr<SourceBuffer> buffer(new SourceBuffer);
+  if (st.st_size > 0) {
+    const auto size = static_cast<std::size_t>(st.st_size);
+    void* const p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      return nullptr;
+    }
+    buffer->mapped_ = p;
+    buffer->data_ = static_cast<const char*>(p);
+    buffer->size_ = size;
+  }
+  ::close(fd);
+  return buffer;
+#else
+  std::ifstream ifs(path, std::ios::binary);
+  if (!ifs) {
+    return nullptr;
+  }
+  using istrbuf_itr = std::istreambuf_iterator<char>;
+  return std::make_shared<SourceBuffer>(
+      std::string{istrbuf_itr(ifs), istrbuf_itr()});
+#endif
+}
+
+SourceBufferPtr SourceBuffer::borrow(StringRef view) {
+  std::shared_ptr<SourceBuffer> buffer(new SourceBuffer);
+  buffer->data_ = view.data();
+  buffer->size_ = view.size();
+  return buffer;
+}
+
+Location SourceBuffer::locate(std::size_t offset) const {
+  std::call_once(lines_once_, [this] { index_lines(); });
+  const auto next = std::upper_bound(line_starts_.begin(), line_starts_.end(),
+                                     offset);
+  const auto line = next - line_starts_.begin();
+  return Location{static_cast<int>(line),
+                  static_cast<int>(offset - *(next - 1)) + 1};
+}
+
+std::size_t SourceBuffer::line_count() const {
+  std::call_once(lines_once_, [this] { index_lines(); });
+  return line_starts_.size();
+}
+
+void SourceBuffer::index_lines() const {
+  line_starts_.push_back(0);
+  const char* const end = data_ + size_;
+  for (const char* p = data_; p < end; ) {
+    const void* const newline = std::memchr(p, '\n', end - p);
+    if (newline == nullptr) break;
+    p = static_cast<const char*>(newline) + 1;
+    line_starts_.push_back(static_cast<std::uint32_t>(p - data_));
+  }
+}
+
+}  // namespace klang
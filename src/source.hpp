@@ -0,0 +1,57 @@
+#ifndef KMC_KLANG_SOURCE_HPP
+#define KMC_KLANG_SOURCE_HPP
+
+#include "string_ref.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace klang {
+
+class SourceBuffer;
+using SourceBufferPtr = std::shared_ptr<const SourceBuffer>;
+
+// ソース上の位置。どちらも 1 から数え、column はバイト単位。
+struct Location {
+  int line;
+  int column;
+};
+
+// 字句解析の入力となる読み取り専用のバッファ。
+// 文字列を所有するもの、ファイルを mmap したもの、
+// 呼び出し側が所有するメモリを参照するだけのものがある。
+class SourceBuffer {
+ public:
+  explicit SourceBuffer(std::string str);
+  ~SourceBuffer();
+  SourceBuffer(const SourceBuffer&) = delete;
+  SourceBuffer& operator=(const SourceBuffer&) = delete;
+  // ファイルを読み取り専用で mmap する。開けなければ nullptr を返す。
+  static SourceBufferPtr map_file(const std::string& path);
+  // view の寿命は呼び出し側が保証する。
+  static SourceBufferPtr borrow(StringRef view);
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  StringRef str() const { return StringRef(data_, size_); }
+  // offset の行と列を二分探索で求める。行頭の表は最初に呼ばれたときに
+  // 一度だけ作る。複数のスレッドから同時に呼んでよい。
+  Location locate(std::size_t offset) const;
+  std::size_t line_count() const;
+ private:
+  SourceBuffer();
+  void index_lines() const;
+  std::string storage_;
+  const char* data_;
+  std::size_t size_;
+  void* mapped_;
+  mutable std::once_flag lines_once_;
+  mutable std::vector<std::uint32_t> line_starts_;
+};
+
+}  // namespace klang
+
+#endif  // KMC_KLANG_SOURCE_HPP
@@ -0,0 +1,70 @@
+#ifndef KMC_KLANG_STRING_REF_HPP
+#define KMC_KLANG_STRING_REF_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+namespace klang {
+
+// 所有権を持たない文字列の参照。参照先の寿命は呼び出し側が保証する。
+class StringRef {
+ public:
+  using const_iterator = const char*;
+  constexpr StringRef()
+      : data_{nullptr}, size_{0}
+  {}
+  constexpr StringRef(const char* data, std::size_t size)
+      : data_{data}, size_{size}
+  {}
+  StringRef(const char* str)
+      : data_{str}, size_{std::strlen(str)}
+  {}
+  StringRef(const std::string& str)
+      : data_{str.data()}, size_{str.size()}
+  {}
+  constexpr const char* data() const { return data_; }
+  constexpr std::size_t size() const { return size_; }
+  constexpr std::size_t length() const { return size_; }
+  constexpr bool empty() const { return size_ == 0; }
+  constexpr const_iterator begin() const { return data_; }
+  constexpr const_iterator end() const { return data_ + size_; }
+  constexpr char operator[](std::size_t i) const { return data_[i]; }
+  std::string str() const {
+    return std::string(data_, size_);
+  }
+  friend bool operator==(StringRef lhs, StringRef rhs) {
+    return lhs.size_ == rhs.size_ &&
+        std::equal(lhs.begin(), lhs.end(), rhs.begin());
+  }
+  friend bool operator!=(StringRef lhs, StringRef rhs) {
+    return !(lhs == rhs);
+  }
+  friend bool operator<(StringRef lhs, StringRef rhs) {
+    return std::lexicographical_compare(lhs.begin(), lhs.end(),
+                                        rhs.begin(), rhs.end());
+  }
+  friend std::ostream& operator<<(std::ostream& os, StringRef str) {
+    return os.write(str.data_, str.size_);
+  }
+ private:
+  const char* data_;
+  std::size_t size_;
+};
+
+struct StringRefHash {
+  std::size_t operator()(StringRef str) const {
+    // FNV-1a
+    std::size_t hash = 2166136261u;
+    for (char c : str) {
+      hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    return hash;
+  }
+};
+
+}  // namespace klang
+
+#endif  // KMC_KLANG_STRING_REF_HPP
@@ -1,6 +1,41 @@
 #include "helper_lexer.hpp"
 
+#include <algorithm>
+#include <memory>
 #include <sstream>
+#include <vector>
+
+klang::TokenVector test::make_tokens(std::initializer_list<TokenSpec> specs) {
+  // トークンは行を持たないので、spec.line の行から始まるように
+  // ソースに改行を入れる。
+  std::string source;
+  std::string literals;
+  std::vector<klang::Token> tokens;
+  int line = 1;
+  for (auto const& spec : specs) {
+    for (; line < spec.line; ++line) source += '\n';
+    auto const offset = static_cast<std::uint32_t>(source.size());
+    source += spec.str;
+    std::uint32_t value = 0;
+    if (spec.type == klang::TokenType::STRING) {
+      // STRING はデコード後の文字列なので、改行は行に数えない。
+      std::replace(source.begin() + offset, source.end(), '\n', ' ');
+      value = klang::TokenVector::add_literal(literals, spec.str);
+    } else {
+      line += static_cast<int>(
+          std::count(spec.str.begin(), spec.str.end(), '\n'));
+    }
+    auto const symbol = (spec.type == klang::TokenType::SYMBOL ?
+                         klang::to_symbol_kind(spec.str) :
+                         klang::SymbolKind::NONE);
+    tokens.push_back(klang::Token(spec.type, offset,
+                                  static_cast<std::uint32_t>(spec.str.size()),
+                                  symbol, value));
+  }
+  return klang::TokenVector(
+      std::make_shared<klang::SourceBuffer>(std::move(source)),
+      std::move(literals), std::move(tokens));
+}
 
 std::string test::to_string(klang::TokenType t){
   if(t == klang::TokenType::IDENTIFIER) return "IDENTIFIER";
@@ -14,14 +49,16 @@ std::string test::to_string(klang::TokenType t){
 
 std::string test::to_string(klang::Token const& t){
   std::ostringstream os;
-  os << to_string(t.type()) << ": " << t.str() << " at Line " << t.line() << "\n";
+  os << to_string(t.type()) << ": [" << t.offset() << ", +" << t.length()
+     << ")\n";
   return os.str();
 }
 
 std::string test::to_string(klang::TokenVector const& vec){
   std::ostringstream os;
   for(auto const& e: vec) {
-    os << to_string(e);
+    os << to_string(e.type()) << ": " << vec.str(e)
+       << " at Line " << vec.location(e).line << "\n";
   }
   return os.str();
 }
@@ -3,9 +3,18 @@
 
 #include "lexer.hpp"
 
+#include <initializer_list>
 #include <string>
 
 namespace test {
+  // 期待値を書くためのトークン。文字列を直接持つ。
+  struct TokenSpec {
+    klang::TokenType type;
+    std::string str;
+    int line;
+  };
+  klang::TokenVector make_tokens(std::initializer_list<TokenSpec> specs);
+
   std::string to_string(klang::TokenType t);
   std::string to_string(klang::Token const& t);
   std::string to_string(klang::TokenVector const& vec);
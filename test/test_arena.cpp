@@ -0,0 +1,47 @@
+#include "gtest.h"
+
+#include "arena.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+TEST(arena, alignment) {
+  klang::ast::Arena arena(64);
+  arena.allocate(1, 1);
+  void* p = arena.allocate(sizeof(double), alignof(double));
+  EXPECT_EQ(0u, reinterpret_cast<std::uintptr_t>(p) % alignof(double));
+  EXPECT_EQ(1u, arena.chunk_count());
+}
+
+TEST(arena, largeAllocation) {
+  klang::ast::Arena arena(64);
+  arena.allocate(16, 1);
+  // チャンクより大きい要求は、専用のチャンクに置かれる。
+  char* p = static_cast<char*>(arena.allocate(1000, 1));
+  p[999] = 'x';
+  EXPECT_EQ(2u, arena.chunk_count());
+  arena.allocate(16, 1);
+  EXPECT_EQ(3u, arena.chunk_count());
+  EXPECT_EQ(1032u, arena.size());
+}
+
+TEST(arena, copy) {
+  klang::ast::Arena arena;
+  std::string str = "identifier";
+  const klang::StringRef copied = arena.copy(str);
+  str = "overwritten";
+  EXPECT_EQ("identifier", copied);
+  EXPECT_TRUE(arena.copy("").empty());
+}
+
+TEST(arena, makeArray) {
+  klang::ast::Arena arena;
+  std::vector<int> elements = {1, 2, 3};
+  const auto array = arena.make_array(elements);
+  ASSERT_EQ(3u, array.size());
+  EXPECT_EQ(1, array[0]);
+  EXPECT_EQ(3, array[2]);
+  std::vector<int> empty;
+  EXPECT_TRUE(arena.make_array(empty).empty());
+}
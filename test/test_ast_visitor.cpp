@@ -0,0 +1,109 @@
+#include "gtest.h"
+
+#include "ast_visitor.hpp"
+#include "parser.hpp"
+
+#include <map>
+#include <string>
+#include <typeinfo>
+
+namespace {
+
+klang::ast::TranslationUnitPtr parse(const std::string& code,
+                                     std::unique_ptr<klang::Parser>& parser) {
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  EXPECT_TRUE(success);
+  parser.reset(new klang::Parser(tokens));
+  return parser->parse_translation_unit();
+}
+
+// すべてのノードを数え、種類と動的な型が食い違わないかも確かめる。
+class Counter : public klang::ast::Visitor<Counter> {
+ public:
+  void visit(klang::ast::Base const& node) {
+    const auto kind = node.kind();
+    auto it = types.emplace(kind, &typeid(node)).first;
+    EXPECT_TRUE(*it->second == typeid(node));
+    ++counts[kind];
+    Visitor<Counter>::visit(node);
+  }
+  std::map<klang::ast::NodeKind, std::type_info const*> types;
+  std::map<klang::ast::NodeKind, int> counts;
+};
+
+// 必要な規則だけを定義し直す。関数呼び出しの中には入らない。
+class Names : public klang::ast::Visitor<Names> {
+ public:
+  void visit_identifier(klang::ast::IdentifierData const& node) {
+    names += node.value().str() + " ";
+  }
+  void visit_function_call_expression(
+      klang::ast::FunctionCallExpressionData const&) {
+    names += "call ";
+  }
+  std::string names;
+};
+
+const char* const code =
+R"(def f(int n) -> (int) {
+  def int var x := n - 1;
+  if (x < 0) { return f(x); } else { ; }
+  for (;;) { break; }
+  while (x) { x :+= 1; continue; }
+  return not x;
+}
+def main() -> (int) {
+  return ("str");
+})";
+
+}  // unnamed namespace
+
+TEST(astVisitor, kind) {
+  using klang::ast::NodeKind;
+  klang::ast::BreakStatementData break_statement;
+  klang::ast::Statement const& statement = break_statement;
+  EXPECT_EQ(NodeKind::BREAK_STATEMENT, statement.kind());
+  klang::ast::IdentifierData identifier(0, 0);
+  EXPECT_EQ(NodeKind::IDENTIFIER, identifier.kind());
+}
+
+TEST(astVisitor, countsAllNodes) {
+  std::unique_ptr<klang::Parser> parser;
+  auto ptu = parse(code, parser);
+  ASSERT_TRUE(ptu != nullptr);
+  Counter counter;
+  counter.visit(*ptu);
+  using klang::ast::NodeKind;
+  EXPECT_EQ(1, counter.counts[NodeKind::TRANSLATION_UNIT]);
+  EXPECT_EQ(2, counter.counts[NodeKind::FUNCTION_DEFINITION]);
+  EXPECT_EQ(1, counter.counts[NodeKind::ARGUMENT]);
+  EXPECT_EQ(1, counter.counts[NodeKind::IF_STATEMENT]);
+  EXPECT_EQ(1, counter.counts[NodeKind::ELSE_STATEMENT]);
+  EXPECT_EQ(1, counter.counts[NodeKind::FOR_STATEMENT]);
+  EXPECT_EQ(1, counter.counts[NodeKind::WHILE_STATEMENT]);
+  EXPECT_EQ(1, counter.counts[NodeKind::BREAK_STATEMENT]);
+  EXPECT_EQ(1, counter.counts[NodeKind::CONTINUE_STATEMENT]);
+  EXPECT_EQ(3, counter.counts[NodeKind::RETURN_STATEMENT]);
+  EXPECT_EQ(1, counter.counts[NodeKind::VARIABLE_DEFINITION]);
+  EXPECT_EQ(1, counter.counts[NodeKind::SUBTRACT_EXPRESSION]);
+  EXPECT_EQ(1, counter.counts[NodeKind::LESS_EXPRESSION]);
+  EXPECT_EQ(1, counter.counts[NodeKind::ADD_ASSIGN_EXPRESSION]);
+  EXPECT_EQ(1, counter.counts[NodeKind::NOT_EXPRESSION]);
+  EXPECT_EQ(1, counter.counts[NodeKind::FUNCTION_CALL_EXPRESSION]);
+  EXPECT_EQ(1, counter.counts[NodeKind::PARAMETER]);
+  EXPECT_EQ(1, counter.counts[NodeKind::PARENTHESIZED_EXPRESSION]);
+  EXPECT_EQ(1, counter.counts[NodeKind::STRING_LITERAL]);
+  // f, n, x, main と、式の中の n, x, f, x, x, x, x
+  EXPECT_EQ(11, counter.counts[NodeKind::IDENTIFIER]);
+}
+
+TEST(astVisitor, override) {
+  std::unique_ptr<klang::Parser> parser;
+  auto ptu = parse(code, parser);
+  ASSERT_TRUE(ptu != nullptr);
+  Names names;
+  names.visit(*ptu);
+  EXPECT_EQ("f n x n x call x x x main ", names.names);
+}
@@ -1,6 +1,9 @@
 #include "either.hpp"
 
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include "gtest.h"
 
@@ -119,3 +122,147 @@ TEST(either, equals) {
   ASSERT_FALSE(e2 == e3);
   ASSERT_TRUE(e2 == e4);
 }
+
+TEST(either, valueOr) {
+  const Either<std::string, int> l(left_tag, "left");
+  const Either<std::string, int> r(right_tag, 1);
+  ASSERT_EQ(0, l.value_or(0));
+  ASSERT_EQ(1, r.value_or(0));
+
+  Either<int, std::unique_ptr<int>> p(right_tag, new int(2));
+  auto moved = std::move(p).value_or(nullptr);
+  ASSERT_EQ(2, *moved);
+  Either<int, std::unique_ptr<int>> none(left_tag, 0);
+  ASSERT_EQ(nullptr, std::move(none).value_or(nullptr));
+}
+
+TEST(either, map) {
+  const Either<std::string, int> l(left_tag, "left");
+  const Either<std::string, int> r(right_tag, 2);
+  const auto twice = [](int x) { return x * 2.5; };
+  const Either<std::string, double> ml = l.map(twice);
+  const Either<std::string, double> mr = r.map(twice);
+  ASSERT_EQ("left", ml.left().value());
+  ASSERT_EQ(5.0, *mr);
+
+  // 右辺値からは値を移して渡す。
+  Either<int, std::unique_ptr<int>> p(right_tag, new int(3));
+  auto m = std::move(p).map([](std::unique_ptr<int> x) { return *x + 1; });
+  ASSERT_EQ(4, *m);
+}
+
+TEST(either, andThen) {
+  const auto half = [](int x) -> Either<std::string, int> {
+    if (x % 2 != 0) return make_left(std::string("odd"));
+    return make_right(x / 2);
+  };
+  const Either<std::string, int> e(right_tag, 12);
+  ASSERT_EQ(3, *e.and_then(half).and_then(half));
+  ASSERT_EQ("odd", e.and_then(half).and_then(half).and_then(half)
+                       .left().value());
+  const Either<std::string, int> l(left_tag, "left");
+  ASSERT_EQ("left", l.and_then(half).left().value());
+}
+
+TEST(either, orElse) {
+  const auto recover = [](std::string const& s) -> Either<int, int> {
+    return make_right(static_cast<int>(s.size()));
+  };
+  const Either<std::string, int> l(left_tag, "left");
+  const Either<std::string, int> r(right_tag, 1);
+  ASSERT_EQ(4, *l.or_else(recover));
+  ASSERT_EQ(1, *r.or_else(recover));
+}
+
+TEST(either, convert) {
+  struct Base { virtual ~Base() {} };
+  struct Derived : Base {};
+  Either<int, std::unique_ptr<Derived>> d(right_tag, new Derived);
+  Derived* const raw = d->get();
+  Either<int, std::unique_ptr<Base>> b = std::move(d);
+  ASSERT_TRUE(b.is_right());
+  ASSERT_EQ(raw, b->get());
+
+  Either<int, std::unique_ptr<Base>> l =
+      Either<int, std::unique_ptr<Derived>>(left_tag, 5);
+  ASSERT_EQ(5, l.left().value());
+}
+
+// 手書きのタグ付き共用体と同じ大きさと性質になるか確かめる。自明に
+// コピーできる型はレジスタで受け渡されるので、呼び出し側のコードも同じに
+// なる。速さは bench/bench_either で比べる。
+namespace {
+
+struct Tagged {
+  bool is_right;
+  union {
+    int left;
+    double right;
+  };
+};
+
+struct Move {
+  Move() = default;
+  Move(Move&&) noexcept {}
+  Move& operator=(Move&&) noexcept { return *this; }
+};
+
+constexpr Either<int, double> constant(bool right) {
+  return right ? Either<int, double>(right_tag, 2.0)
+               : Either<int, double>(left_tag, 1);
+}
+
+}  // unnamed namespace
+
+TEST(either, layout) {
+  using E = Either<int, double>;
+  static_assert(sizeof(E) == sizeof(Tagged), "same size as a tagged union");
+  static_assert(alignof(E) == alignof(Tagged), "same alignment");
+  static_assert(std::is_trivially_copyable<E>::value, "trivially copyable");
+  static_assert(std::is_trivially_destructible<E>::value,
+                "trivially destructible");
+  static_assert(std::is_trivially_copyable<Either<char, int*>>::value,
+                "trivially copyable");
+  static_assert(!std::is_trivially_destructible<
+                    Either<int, std::string>>::value,
+                "destroys a string");
+}
+
+TEST(either, constexpr) {
+  constexpr auto l = constant(false);
+  constexpr auto r = constant(true);
+  static_assert(l.is_left() && !l, "left");
+  static_assert(r.is_right() && *r == 2.0, "right");
+  static_assert(l.value_or(3.0) == 3.0, "value_or");
+  // C++11 の constexpr なメンバ関数は const になるので、右辺値からの
+  // 変換は constexpr にできない。
+  constexpr Left<int> five(5);
+  constexpr Either<int, double> e = five;
+  static_assert(e.is_left(), "left");
+  ASSERT_EQ(5, e.left().value());
+}
+
+TEST(either, moveOnly) {
+  using E = Either<int, std::unique_ptr<int>>;
+  static_assert(!std::is_copy_constructible<E>::value, "move only");
+  static_assert(!std::is_copy_assignable<E>::value, "move only");
+  static_assert(std::is_nothrow_move_constructible<E>::value, "noexcept");
+  static_assert(std::is_nothrow_move_assignable<E>::value, "noexcept");
+  static_assert(std::is_nothrow_move_constructible<Either<Move, int>>::value,
+                "noexcept");
+  static_assert(!std::is_nothrow_copy_constructible<
+                    Either<int, std::string>>::value,
+                "copying a string may throw");
+
+  E e(right_tag, new int(1));
+  E moved = std::move(e);
+  ASSERT_EQ(1, **moved);
+  e = E(left_tag, 2);
+  swap(e, moved);
+  ASSERT_EQ(1, **e);
+  ASSERT_EQ(2, moved.left().value());
+  // 要素を移すときに noexcept のムーブを使う。
+  std::vector<E> v;
+  for (int i = 0; i < 100; ++i) v.emplace_back(right_tag, new int(i));
+  ASSERT_EQ(99, **v.back());
+}
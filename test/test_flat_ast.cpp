@@ -0,0 +1,107 @@
+#include "gtest.h"
+
+#include "flat_ast.hpp"
+#include "parser.hpp"
+#include "ast_data.hpp"
+
+#include <string>
+
+namespace {
+
+klang::ast::TranslationUnitPtr parse(const std::string& code,
+                                     std::unique_ptr<klang::Parser>& parser) {
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  EXPECT_TRUE(success);
+  parser.reset(new klang::Parser(tokens));
+  return parser->parse_translation_unit();
+}
+
+}  // unnamed namespace
+
+TEST(flatAst, structure) {
+  std::unique_ptr<klang::Parser> parser;
+  auto ptu = parse(
+R"(def f(int n) -> (int) {
+  def int var x := n - 1 - 2;
+  if (x < 0) { return f(x); } else { ; }
+  for (;;) { break; }
+}
+def main() -> (int) {
+  return "str";
+})", parser);
+  ASSERT_TRUE(ptu != nullptr);
+  using klang::flat::NodeKind;
+  const auto tree = klang::flat::flatten(*ptu);
+  const auto root = tree.root();
+  EXPECT_EQ(NodeKind::TRANSLATION_UNIT, tree.kind(root));
+  EXPECT_EQ(tree.size(), tree.end(root));
+  ASSERT_EQ(2u, tree.child_count(root));
+
+  const auto f = tree.child(root, 0);
+  EXPECT_EQ(NodeKind::FUNCTION_DEFINITION, tree.kind(f));
+  EXPECT_EQ("f", tree.str(tree.child(f, 0)));
+  const auto arguments = tree.child(f, 1);
+  ASSERT_EQ(1u, tree.child_count(arguments));
+  EXPECT_EQ("int", tree.str(tree.child(tree.child(arguments, 0), 0)));
+  EXPECT_EQ("n", tree.str(tree.child(tree.child(arguments, 0), 1)));
+  EXPECT_EQ(NodeKind::TYPE, tree.kind(tree.child(f, 2)));
+
+  const auto body = tree.child(f, 3);
+  ASSERT_EQ(3u, tree.child_count(body));
+  const auto definition = tree.child(body, 0);
+  EXPECT_EQ(NodeKind::VARIABLE_DEFINITION, tree.kind(definition));
+  EXPECT_TRUE(tree[definition].is_mutable);
+  EXPECT_EQ("x", tree.str(tree.child(definition, 1)));
+  // (n - 1) - 2
+  const auto sub = tree.child(definition, 2);
+  EXPECT_EQ(NodeKind::SUBTRACT, tree.kind(sub));
+  EXPECT_EQ(NodeKind::SUBTRACT, tree.kind(tree.child(sub, 0)));
+  EXPECT_EQ("2", tree.str(tree.child(sub, 1)));
+
+  const auto if_ = tree.child(body, 1);
+  ASSERT_EQ(3u, tree.child_count(if_));
+  const auto call = tree.child(tree.child(tree.child(if_, 1), 0), 0);
+  EXPECT_EQ(NodeKind::FUNCTION_CALL, tree.kind(call));
+  EXPECT_EQ(2u, tree.child_count(call));
+  const auto else_ = tree.child(if_, 2);
+  EXPECT_EQ(NodeKind::ELSE_STATEMENT, tree.kind(else_));
+  EXPECT_EQ(NodeKind::EMPTY,
+            tree.kind(tree.child(tree.child(tree.child(else_, 0), 0), 0)));
+
+  const auto for_ = tree.child(body, 2);
+  ASSERT_EQ(4u, tree.child_count(for_));
+  EXPECT_EQ(NodeKind::EMPTY, tree.kind(tree.child(for_, 0)));
+  EXPECT_EQ(NodeKind::BREAK_STATEMENT,
+            tree.kind(tree.child(tree.child(for_, 3), 0)));
+
+  const auto main = tree.child(root, 1);
+  const auto literal = tree.child(tree.child(tree.child(main, 3), 0), 0);
+  EXPECT_EQ(NodeKind::STRING_LITERAL, tree.kind(literal));
+  EXPECT_EQ("str", tree.str(literal));
+  // 同じ名前は一度だけ表に入る。
+  EXPECT_EQ(5u, tree.names().size());
+}
+
+TEST(flatAst, memoryUsage) {
+  std::string code;
+  for (int i = 0; i < 200; ++i) {
+    const std::string name = "f" + std::to_string(i);
+    code += "def " + name + "(int a) -> (int) {\n"
+        "  def int var x := a * 2 + 1;\n"
+        "  if (x < 10 and a =/ 3) { x :+= " + name + "(a - 1); }\n"
+        "  while (x > 0) { x :-= 1; }\n"
+        "  return x;\n"
+        "}\n";
+  }
+  std::unique_ptr<klang::Parser> parser;
+  auto ptu = parse(code, parser);
+  ASSERT_TRUE(ptu != nullptr);
+  auto const& tu = dynamic_cast<klang::ast::TranslationUnitData const&>(*ptu);
+  ASSERT_EQ(200u, tu.functions().size());
+  const auto tree = klang::flat::flatten(*ptu);
+  const std::size_t pointer_tree = tu.arena()->size() +
+      tu.functions().capacity() * sizeof(klang::ast::FunctionDefinitionPtr);
+  EXPECT_LE(tree.memory_usage() * 3, pointer_tree);
+}
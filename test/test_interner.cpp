@@ -0,0 +1,70 @@
+#include "gtest.h"
+
+#include "interner.hpp"
+#include "lexer.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(interner, sameSpelling) {
+  klang::Interner interner;
+  const auto foo = interner.intern("foo");
+  const auto bar = interner.intern("bar");
+  std::string spelling = "foo";
+  EXPECT_EQ(foo, interner.intern(spelling));
+  EXPECT_NE(foo, bar);
+  // 綴りは写しを持つので、元の文字列が変わっても影響しない。
+  spelling[0] = 'g';
+  EXPECT_EQ("foo", interner.str(foo));
+  EXPECT_EQ("bar", interner.str(bar));
+  EXPECT_EQ(2u, interner.size());
+}
+
+TEST(interner, denseIds) {
+  klang::Interner interner;
+  // ブロックの境目をいくつかまたぐ。
+  for (int i = 0; i < 10000; ++i) {
+    EXPECT_EQ(klang::Interner::Id(i), interner.intern("x" + std::to_string(i)));
+  }
+  for (int i = 0; i < 10000; ++i) {
+    EXPECT_EQ("x" + std::to_string(i), interner.str(i));
+  }
+}
+
+TEST(interner, threads) {
+  klang::Interner interner;
+  const int count = 2000;
+  std::vector<std::vector<klang::Interner::Id>> ids(4);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < count; ++i) {
+        // スレッドごとに違う順番で同じ名前を登録する。
+        const int n = (t % 2 == 0) ? i : count - 1 - i;
+        ids[t].push_back(interner.intern("name" + std::to_string(n)));
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(std::size_t(count), interner.size());
+  for (int i = 0; i < count; ++i) {
+    EXPECT_EQ(ids[0][i], ids[2][i]);
+    EXPECT_EQ(ids[0][i], ids[1][count - 1 - i]);
+    EXPECT_EQ("name" + std::to_string(i), interner.str(ids[0][i]));
+  }
+}
+
+TEST(interner, tokens) {
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) =
+      klang::tokenize(klang::StringRef("abc def xyz abc"));
+  ASSERT_EQ(4u, tokens.size());
+  auto& interner = klang::Interner::global();
+  EXPECT_EQ(tokens[0].id(), tokens[3].id());
+  EXPECT_NE(tokens[0].id(), tokens[2].id());
+  EXPECT_EQ("abc", interner.str(tokens[0].id()));
+  EXPECT_EQ("xyz", interner.str(tokens[2].id()));
+}
@@ -1,10 +1,14 @@
 #include "lexer.hpp"
 #include "helper_lexer.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
 #include "gtest.h"
 
 namespace {
-    using T = klang::Token;
+    using T = test::TokenSpec;
     using klang::TokenType;
 }
 
@@ -27,7 +31,7 @@ R"(def main() -> (int) {
   bool success;
   std::tie(success, tokens) = klang::tokenize(is);
   EXPECT_TRUE(success);
-  klang::TokenVector const expect = {
+  klang::TokenVector const expect = test::make_tokens({
       T{TokenType::SYMBOL, "def", 1},
       T{TokenType::IDENTIFIER, "main", 1},
       T{TokenType::SYMBOL, "(", 1},
@@ -41,7 +45,7 @@ R"(def main() -> (int) {
       T{TokenType::NUMBER, "0", 2},
       T{TokenType::SYMBOL, ";", 2},
       T{TokenType::SYMBOL, "}", 3},
-  };
+  });
   ASSERT_EQ(expect, tokens);
 }
 
@@ -63,7 +67,7 @@ def main() -> (int) {
   bool success;
   std::tie(success, tokens) = klang::tokenize(is);
   EXPECT_TRUE(success);
-  klang::TokenVector const expect = {
+  klang::TokenVector const expect = test::make_tokens({
       T{TokenType::SYMBOL, "def", 7},
       T{TokenType::IDENTIFIER, "main", 7},
       T{TokenType::SYMBOL, "(", 7},
@@ -82,7 +86,7 @@ def main() -> (int) {
       T{TokenType::NUMBER, "0", 9},
       T{TokenType::SYMBOL, ";", 9},
       T{TokenType::SYMBOL, "}", 10},
-  };
+  });
   ASSERT_EQ(expect, tokens);
 }
 
@@ -98,10 +102,10 @@ def placeholder
   bool success;
   std::tie(success, tokens) = klang::tokenize(is);
   EXPECT_TRUE(success);
-  klang::TokenVector const expect = {
+  klang::TokenVector const expect = test::make_tokens({
       T{TokenType::SYMBOL, "def", 4},
       T{TokenType::IDENTIFIER, "placeholder", 4},
-  };
+  });
   ASSERT_EQ(expect, tokens);
 }
 
@@ -130,3 +134,332 @@ TEST(lexer, brokenComment2) {
   EXPECT_FALSE(success);
   ASSERT_EQ(klang::TokenVector(), tokens);
 }
+
+TEST(lexer, longTokens) {
+  // 長いトークンでも線形時間で字句解析できる
+  std::string const body(1 << 20, 'a');
+  std::stringstream is;
+  is << "{~" << body << "~}\n"
+     << "~~" << body << "\n"
+     << body << " \"" << body << "\"";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(is);
+  EXPECT_TRUE(success);
+  klang::TokenVector const expect = test::make_tokens({
+      T{TokenType::IDENTIFIER, body, 3},
+      T{TokenType::STRING, body, 3},
+  });
+  ASSERT_EQ(expect, tokens);
+}
+
+TEST(lexer, bufferView) {
+  // 末尾に改行がなくてもよい
+  std::string const code = "def main";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  EXPECT_TRUE(success);
+  klang::TokenVector const expect = test::make_tokens({
+      T{TokenType::SYMBOL, "def", 1},
+      T{TokenType::IDENTIFIER, "main", 1},
+  });
+  ASSERT_EQ(expect, tokens);
+  EXPECT_EQ(code.data(), tokens.source()->data());
+}
+
+TEST(lexer, tokenizeFile) {
+  char const* const path = "test_lexer_tokenize_file.k";
+  {
+    std::ofstream ofs(path, std::ios::binary);
+    ofs << "def main() -> (int) {\n  return \"0\";\n}";
+  }
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize_file(path);
+  std::remove(path);
+  EXPECT_TRUE(success);
+  klang::TokenVector const expect = test::make_tokens({
+      T{TokenType::SYMBOL, "def", 1},
+      T{TokenType::IDENTIFIER, "main", 1},
+      T{TokenType::SYMBOL, "(", 1},
+      T{TokenType::SYMBOL, ")", 1},
+      T{TokenType::SYMBOL, "->", 1},
+      T{TokenType::SYMBOL, "(", 1},
+      T{TokenType::SYMBOL, "int", 1},
+      T{TokenType::SYMBOL, ")", 1},
+      T{TokenType::SYMBOL, "{", 1},
+      T{TokenType::SYMBOL, "return", 2},
+      T{TokenType::STRING, "0", 2},
+      T{TokenType::SYMBOL, ";", 2},
+      T{TokenType::SYMBOL, "}", 3},
+  });
+  ASSERT_EQ(expect, tokens);
+}
+
+TEST(lexer, tokenizeMissingFile) {
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize_file("no/such/file.k");
+  EXPECT_FALSE(success);
+  ASSERT_EQ(klang::TokenVector(), tokens);
+}
+
+TEST(lexer, location) {
+  // 行と列はトークンの先頭の位置で、どちらも 1 から数える。
+  std::string const code = "def f\n  {~ a\n b ~} x \"s\nt\" y";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  EXPECT_TRUE(success);
+  ASSERT_EQ(5u, tokens.size());
+  int const expect[][2] = {{1, 1}, {1, 5}, {3, 7}, {3, 9}, {4, 4}};
+  for (std::size_t i = 0; i < tokens.size(); ++i) {
+    klang::Location const location = tokens.location(tokens[i]);
+    EXPECT_EQ(expect[i][0], location.line) << i;
+    EXPECT_EQ(expect[i][1], location.column) << i;
+  }
+  EXPECT_EQ("s\nt", tokens.str(tokens[3]));
+  EXPECT_EQ(4u, tokens.source()->line_count());
+  // 末尾の位置も最後の行に入る。
+  klang::Location const end = tokens.source()->locate(code.size());
+  EXPECT_EQ(4, end.line);
+  EXPECT_EQ(5, end.column);
+}
+
+TEST(lexer, stringLiteral) {
+  std::string const code =
+      "\"plain\" \"a\\tb\\\\c\\\"\" \"\" \"a\\tb\\\\c\\\"\" \"\\q\\0\"";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  EXPECT_TRUE(success);
+  ASSERT_EQ(5u, tokens.size());
+  // エスケープがなければソースを指すだけで、リテラル表を使わない。
+  EXPECT_FALSE(tokens[0].decoded());
+  EXPECT_EQ("plain", tokens.str(tokens[0]));
+  EXPECT_EQ(code.data() + 1, tokens.str(tokens[0]).data());
+  EXPECT_FALSE(tokens[2].decoded());
+  EXPECT_EQ("", tokens.str(tokens[2]));
+  EXPECT_TRUE(tokens[1].decoded());
+  EXPECT_EQ("a\tb\\c\"", tokens.str(tokens[1]));
+  EXPECT_EQ(std::string("q\0", 2), tokens.str(tokens[4]));
+  // 同じ綴りのリテラルは一度だけデコードする。
+  EXPECT_EQ(tokens[1].literal(), tokens[3].literal());
+  EXPECT_EQ(2 * sizeof(std::uint32_t) + 6 + 2, tokens.literals().size());
+}
+
+TEST(lexer, charClass) {
+  // 文字の分類はロケールに依らない。空白は std::isspace と同じ 6 文字。
+  std::string const code = "a_1\t_b\v0\f9\r\n";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  EXPECT_TRUE(success);
+  klang::TokenVector const expect = test::make_tokens({
+      T{TokenType::IDENTIFIER, "a_1", 1},
+      T{TokenType::IDENTIFIER, "_b", 1},
+      T{TokenType::NUMBER, "0", 1},
+      T{TokenType::NUMBER, "9", 1},
+  });
+  ASSERT_EQ(expect, tokens);
+  // ASCII 以外の文字は識別子にならない。
+  for (char const* bad : {"caf\xc3\xa9", "\xa0", "x\x7f"}) {
+    std::tie(success, tokens) = klang::tokenize(klang::StringRef(bad));
+    EXPECT_FALSE(success) << bad;
+  }
+}
+
+TEST(lexer, symbolKind) {
+  using klang::SymbolKind;
+  std::string const code = "def x :%= ~} continue iff";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  EXPECT_TRUE(success);
+  ASSERT_EQ(6u, tokens.size());
+  EXPECT_EQ(SymbolKind::DEF, tokens[0].symbol());
+  EXPECT_EQ(SymbolKind::NONE, tokens[1].symbol());
+  EXPECT_EQ(SymbolKind::MODULO_ASSIGN, tokens[2].symbol());
+  EXPECT_EQ(SymbolKind::CLOSE_COMMENT, tokens[3].symbol());
+  EXPECT_EQ(SymbolKind::CONTINUE, tokens[4].symbol());
+  EXPECT_EQ(TokenType::IDENTIFIER, tokens[5].type());
+  EXPECT_EQ(SymbolKind::NONE, tokens[5].symbol());
+  for (auto const& t : tokens) {
+    if (t.type() == TokenType::SYMBOL) {
+      EXPECT_EQ(tokens.str(t), klang::to_string(t.symbol()));
+    }
+  }
+}
+
+namespace {
+
+// 文字列やネストしたコメントが改行をまたぐ入力。
+std::string mixed_source(int count) {
+  std::string const pieces[] = {
+    "def main() -> (int) {\n",
+    "  x := \"a\nb\\\"\n\";\n",
+    "{~ outer {~ inner\n~}\n still comment\n~}\n",
+    "~~ line comment {~\n",
+    "  y :+= 0123 + ab1 - ~x;\n",
+    "{~}\n~}\n",
+    "\n\n\n",
+  };
+  std::string code;
+  unsigned state = 1;
+  for (int i = 0; i < count; ++i) {
+    state = state * 1103515245u + 12345u;
+    code += pieces[(state >> 16) % (sizeof(pieces) / sizeof(pieces[0]))];
+  }
+  return code;
+}
+
+}  // unnamed namespace
+
+TEST(lexer, parallel) {
+  // 分割位置の改行が文字列やネストしたコメントの中に入る入力も含める。
+  std::string const code = mixed_source(300);
+  for (std::string const& source :
+       {code, code + "\"unterminated\n\n", code + "$" + code, std::string()}) {
+    bool expect_success;
+    klang::TokenVector expect;
+    std::tie(expect_success, expect) =
+        klang::tokenize(klang::StringRef(source));
+    for (unsigned jobs : {1u, 2u, 3u, 8u, 64u}) {
+      bool success;
+      klang::TokenVector tokens;
+      std::tie(success, tokens) = klang::tokenize_in_parallel(
+          klang::SourceBuffer::borrow(klang::StringRef(source)), jobs);
+      EXPECT_EQ(expect_success, success);
+      EXPECT_EQ(expect, tokens);
+    }
+  }
+}
+
+TEST(lexer, stream) {
+  std::string const code = mixed_source(300);
+  for (std::string const& source :
+       {code, code + "\"unterminated\n\n", code + "$" + code, std::string()}) {
+    bool expect_success;
+    klang::TokenVector expect;
+    std::tie(expect_success, expect) =
+        klang::tokenize(klang::StringRef(source));
+    for (std::size_t chunk_size : {1u, 7u, 4096u}) {
+      klang::TokenStream stream(
+          klang::SourceBuffer::borrow(klang::StringRef(source)), chunk_size);
+      std::size_t i = 0;
+      for (; klang::Token const* token = stream.peek(); stream.advance(), ++i) {
+        ASSERT_LT(i, expect.size());
+        EXPECT_EQ(expect[i], *token);
+        EXPECT_EQ(expect.str(expect[i]), stream.str(*token));
+      }
+      EXPECT_EQ(expect.size(), i);
+      EXPECT_EQ(expect_success, !stream.failed());
+      if (chunk_size == 1) {
+        // Mark がなければ先読みの窓しか持たない。
+        EXPECT_LT(stream.peak_window_size(), 16u);
+      }
+    }
+  }
+}
+
+TEST(lexer, streamMark) {
+  std::string const code = mixed_source(300);
+  klang::TokenVector expect;
+  std::tie(std::ignore, expect) = klang::tokenize(klang::StringRef(code));
+  klang::TokenStream stream(
+      klang::SourceBuffer::borrow(klang::StringRef(code)), 1);
+  for (int i = 0; i < 10; ++i) {
+    ASSERT_TRUE(stream.peek() != nullptr);
+    stream.advance();
+  }
+  {
+    const auto mark = stream.mark();
+    for (int i = 0; i < 200; ++i) {
+      ASSERT_TRUE(stream.peek() != nullptr);
+      stream.advance();
+    }
+    // Mark より後ろのトークンは捨てられていない。
+    EXPECT_LE(200u, stream.window_size());
+    EXPECT_EQ(expect[10], stream[mark.position()]);
+    stream.reset(mark);
+    EXPECT_EQ(10u, stream.position());
+    ASSERT_TRUE(stream.peek() != nullptr);
+    EXPECT_EQ(expect[10], *stream.peek());
+  }
+  while (stream.peek()) stream.advance();
+  EXPECT_EQ(expect.size(), stream.position());
+  EXPECT_GT(200u + 16u, stream.window_size());
+}
+
+TEST(lexer, retokenize) {
+  std::string const code = mixed_source(100);
+  bool success;
+  klang::TokenVector tokens;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  // コメントや文字列を開く・閉じる編集で、後ろのトークンの意味が変わる。
+  std::string const insertions[] = {
+    "", "a", "1", " ", "\n", "{~", "~}", "\"", "~~", "$", ":=", "'x'",
+  };
+  unsigned state = 7;
+  for (int i = 0; i < 500; ++i) {
+    state = state * 1103515245u + 12345u;
+    std::size_t const offset = (state >> 8) % (code.size() + 1);
+    std::size_t const removed =
+        std::min<std::size_t>((state >> 4) % 3, code.size() - offset);
+    std::string const& inserted =
+        insertions[(state >> 16) % (sizeof(insertions) / sizeof(insertions[0]))];
+    std::string edited = code;
+    edited.replace(offset, removed, inserted);
+    auto const source = klang::SourceBuffer::borrow(klang::StringRef(edited));
+    bool expect_success;
+    klang::TokenVector expect;
+    std::tie(expect_success, expect) = klang::tokenize(source);
+    bool actual_success;
+    klang::TokenVector actual;
+    std::tie(actual_success, actual) = klang::retokenize(
+        tokens, source, klang::Edit{offset, removed, inserted.size()});
+    EXPECT_EQ(expect_success, actual_success);
+    EXPECT_EQ(expect, actual);
+  }
+}
+
+TEST(lexer, retokenizeLiterals) {
+  // エスケープを含むリテラルの中を何度書き換えても、リテラル表は伸び続けない。
+  std::string code = "x := \"a\\n\"; y := \"b\\t\"; z := \"b\\t\";";
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+  std::size_t const offset = code.find('a');
+  // 前の版のトークンはその版のソースを指すので、ソースを動かさない。
+  std::vector<std::string> sources;
+  sources.reserve(101);
+  std::size_t first_size = 0;
+  for (int i = 0; i < 100; ++i) {
+    std::string edited = code;
+    edited[offset] = static_cast<char>('a' + i % 26);
+    sources.push_back(edited);
+    auto const source = klang::SourceBuffer::borrow(
+        klang::StringRef(sources.back()));
+    klang::TokenVector expect;
+    std::tie(std::ignore, expect) = klang::tokenize(source);
+    klang::TokenVector actual;
+    std::tie(std::ignore, actual) = klang::retokenize(
+        tokens, source, klang::Edit{offset, 1, 1});
+    EXPECT_EQ(expect, actual);
+    if (i == 0) first_size = actual.literals().size();
+    EXPECT_EQ(first_size, actual.literals().size());
+    code = edited;
+    tokens = actual;
+  }
+  // リテラルの外の編集では、表を写さずに共有する。
+  sources.push_back("w" + code);
+  auto const source = klang::SourceBuffer::borrow(
+      klang::StringRef(sources.back()));
+  klang::TokenVector actual;
+  std::tie(std::ignore, actual) = klang::retokenize(
+      tokens, source, klang::Edit{0, 0, 1});
+  klang::TokenVector expect;
+  std::tie(std::ignore, expect) = klang::tokenize(source);
+  EXPECT_EQ(expect, actual);
+  EXPECT_EQ(tokens.literals().data(), actual.literals().data());
+}
@@ -16,12 +16,12 @@ def placeholder
   bool success;
   std::tie(success, tokens) = klang::tokenize(is);
   EXPECT_TRUE(success);
-  using T = klang::Token;
+  using T = test::TokenSpec;
   using klang::TokenType;
-  klang::TokenVector const expect = {
+  klang::TokenVector const expect = test::make_tokens({
       T{TokenType::SYMBOL, "def", 5},
       T{TokenType::IDENTIFIER, "placeholder", 5},
-  };
+  });
   ASSERT_EQ(expect, tokens);
 }
 
@@ -1,6 +1,13 @@
 #include "gtest.h"
 
 #include "parser.hpp"
+#include "ast_data.hpp"
+#include "ast_visitor.hpp"
+#include "flat_ast.hpp"
+
+#include <algorithm>
+#include <string>
+#include <vector>
 
 TEST(parser, emptySource) {
   std::stringstream is;
@@ -27,3 +34,566 @@ R"(def main() -> (int) {
   klang::Parser p(tokens);
   EXPECT_TRUE(p.parse_translation_unit() != nullptr);
 }
+
+TEST(parser, statements) {
+  std::stringstream is;
+  is <<
+R"(def f(int n) -> (int) {
+  def int var x := 0;
+  def int y := ~n * 2 + 1;
+  x :+= 1; x :-= 2; x :*= 3; x :/= 4; x :%= 5;
+  if (x = y and not (x =/ 0) or x < 1) {
+    x := x - 1;
+  } else if (x > 1) {
+    x := x / 2 % 3;
+  } else {
+    x := x <= y;
+    x := x >= y;
+  }
+  while (1) { break; }
+  for (x := 0; x < 10; x :+= 1) { continue; }
+  for (;;) { }
+  f(x);
+  ;
+  return x;
+}
+def main() -> (int) {
+  return f(1);
+})";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(is);
+  EXPECT_TRUE(success);
+  klang::Parser p(tokens);
+  auto ptu = p.parse_translation_unit();
+  ASSERT_TRUE(ptu != nullptr);
+  auto const& tu = dynamic_cast<klang::ast::TranslationUnitData const&>(*ptu);
+  EXPECT_EQ(2u, tu.functions().size());
+}
+
+TEST(parser, memoized) {
+  std::stringstream is;
+  is <<
+R"(def main() -> (int) {
+  x := f(((((((((((((((((((((((((((((((( x )))))))))))))))))))))))))))))));
+  y := f(((((((((((((((((((((((((((((((( x ))))))))))))))))))))))))))))));
+  return x;
+})";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(is);
+  EXPECT_TRUE(success);
+  klang::Parser p(tokens, true);
+  auto ptu = p.parse_translation_unit();
+  ASSERT_TRUE(ptu != nullptr);
+  // 2 文目は閉じ括弧が足りないので、main の定義全体が失敗する。
+  auto const& tu = dynamic_cast<klang::ast::TranslationUnitData const&>(*ptu);
+  EXPECT_EQ(0u, tu.functions().size());
+}
+
+TEST(parser, leftAssociative) {
+  std::stringstream is;
+  is << "a - b - c * d / e";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(is);
+  EXPECT_TRUE(success);
+  klang::Parser p(tokens);
+  auto pexpr = p.parse_expression();
+  ASSERT_TRUE(pexpr.is_right());
+  using namespace klang::ast;
+  // ((a - b) - ((c * d) / e))
+  auto sub = dynamic_cast<SubtractExpressionData const*>(pexpr->get());
+  ASSERT_TRUE(sub != nullptr);
+  auto lhs = dynamic_cast<SubtractExpressionData const*>(sub->lhs().get());
+  ASSERT_TRUE(lhs != nullptr);
+  auto a = dynamic_cast<IdentifierExpressionData const*>(lhs->lhs().get());
+  ASSERT_TRUE(a != nullptr);
+  EXPECT_EQ("a",
+            dynamic_cast<IdentifierData const&>(*a->expression()).value());
+  auto div = dynamic_cast<DivideExpressionData const*>(sub->rhs().get());
+  ASSERT_TRUE(div != nullptr);
+  EXPECT_TRUE(dynamic_cast<MultiplyExpressionData const*>(div->lhs().get()));
+}
+
+TEST(parser, nonAssociative) {
+  std::stringstream is;
+  is << "a < b < c";
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(is);
+  EXPECT_TRUE(success);
+  klang::Parser p(tokens);
+  // 比較は連鎖しないので、a < b だけを読んで止まる。
+  auto pexpr = p.parse_expression();
+  ASSERT_TRUE(pexpr.is_right());
+  EXPECT_TRUE(
+      dynamic_cast<klang::ast::LessExpressionData const*>(pexpr->get()));
+  EXPECT_TRUE(p.parse_symbol(klang::SymbolKind::LESS));
+}
+
+TEST(parser, nonAssociativeInRhs) {
+  using klang::SymbolKind;
+  // 右辺が断った比較を、外側の弱い演算子の後で拾ってはいけない。
+  const std::pair<const char*, SymbolKind> cases[] = {
+    {"x and a < b < c", SymbolKind::LESS},
+    {"x or a = b = c", SymbolKind::EQUAL},
+  };
+  for (bool explicit_stack : {false, true}) {
+    for (auto const& c : cases) {
+      klang::TokenVector tokens;
+      std::tie(std::ignore, tokens) =
+          klang::tokenize(klang::StringRef(c.first));
+      klang::Parser p(tokens);
+      if (explicit_stack) p.use_explicit_stack();
+      auto pexpr = p.parse_expression();
+      ASSERT_TRUE(pexpr.is_right()) << c.first;
+      EXPECT_TRUE(
+          dynamic_cast<klang::ast::AndExpressionData const*>(pexpr->get()) ||
+          dynamic_cast<klang::ast::OrExpressionData const*>(pexpr->get()))
+          << c.first << ", " << explicit_stack;
+      EXPECT_TRUE(p.parse_symbol(c.second)) << c.first;
+    }
+  }
+}
+
+namespace {
+
+klang::ParseError statement_error(const std::string& code,
+                                  bool explicit_stack) {
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+  klang::Parser p(tokens);
+  if (explicit_stack) p.use_explicit_stack();
+  auto statement = p.parse_statement();
+  EXPECT_TRUE(statement.is_left()) << code;
+  return statement.is_left() ? statement.left().value()
+                             : klang::ParseError{0, 0};
+}
+
+}  // unnamed namespace
+
+TEST(parser, parseError) {
+  using klang::ParseError;
+  using klang::SymbolKind;
+  // 最も先の読めなかった位置と、そこで読めたはずのものを返す。
+  for (bool explicit_stack : {false, true}) {
+    const auto paren = statement_error("return (1 ;", explicit_stack);
+    EXPECT_EQ(3u, paren.position);
+    EXPECT_TRUE(paren.expected & ParseError::symbol(SymbolKind::RIGHT_PAREN));
+    EXPECT_TRUE(paren.expected & ParseError::symbol(SymbolKind::PLUS));
+    EXPECT_FALSE(paren.expected & ParseError::symbol(SymbolKind::SEMICOLON));
+
+    const auto operand = statement_error("x := not ;", explicit_stack);
+    EXPECT_EQ(3u, operand.position);
+    EXPECT_TRUE(operand.expected & ParseError::IDENTIFIER);
+    EXPECT_TRUE(operand.expected & ParseError::NUMBER);
+    EXPECT_TRUE(operand.expected & ParseError::symbol(SymbolKind::NOT));
+    EXPECT_FALSE(operand.expected & ParseError::TYPE);
+
+    const auto type = statement_error("def 1 x := 1;", explicit_stack);
+    EXPECT_EQ(1u, type.position);
+    EXPECT_EQ(ParseError::TYPE, type.expected);
+  }
+  // どちらの読み方でも同じ集合になる。
+  for (const char* code : {"f(1, ;", "while (x) { y := 1 2; }", "x := f(;"}) {
+    const auto recursive = statement_error(code, false);
+    const auto explicit_stack = statement_error(code, true);
+    EXPECT_EQ(recursive.position, explicit_stack.position) << code;
+    EXPECT_EQ(recursive.expected, explicit_stack.expected) << code;
+  }
+}
+
+namespace {
+
+std::string functions(int count) {
+  std::string code;
+  for (int i = 0; i < count; ++i) {
+    const std::string name = "f" + std::to_string(i);
+    code += "def " + name + "(int a) -> (int) {\n"
+        "  if (a < 10) { return " + name + "(a - 1); } else { }\n"
+        "  return a;\n"
+        "}\n";
+  }
+  return code;
+}
+
+void expect_same_as_sequential(const std::string& code,
+                               std::size_t expected_functions) {
+  klang::TokenVector tokens;
+  bool success;
+  std::tie(success, tokens) = klang::tokenize(klang::StringRef(code));
+  EXPECT_TRUE(success);
+  klang::Parser sequential(tokens);
+  const auto expected = sequential.parse_translation_unit();
+  for (unsigned jobs : {1u, 4u}) {
+    klang::Parser parallel(tokens);
+    const auto actual = parallel.parse_translation_unit_in_parallel(jobs);
+    auto const& tu =
+        dynamic_cast<klang::ast::TranslationUnitData const&>(*actual);
+    EXPECT_EQ(expected_functions, tu.functions().size());
+    EXPECT_TRUE(klang::flat::flatten(*expected) ==
+                klang::flat::flatten(*actual));
+  }
+}
+
+}  // unnamed namespace
+
+TEST(parser, parallel) {
+  expect_same_as_sequential(functions(100), 100);
+  expect_same_as_sequential("", 0);
+  // 途中の関数が壊れていれば、逐次版と同じくそこで止まる。
+  expect_same_as_sequential(functions(10) + "def g( {}\n" + functions(10), 10);
+  // 余分な閉じ括弧で区切りがずれても、逐次版と同じ結果になる。
+  expect_same_as_sequential(functions(3) + "}\n" + functions(3), 3);
+  expect_same_as_sequential("x;\n" + functions(3), 0);
+}
+
+TEST(parser, stream) {
+  const std::string code = functions(200);
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+  klang::Parser sequential(tokens);
+  const auto expected = sequential.parse_translation_unit();
+  klang::Parser streaming(klang::TokenStream(
+      klang::SourceBuffer::borrow(klang::StringRef(code)), 64));
+  const auto actual = streaming.parse_translation_unit();
+  EXPECT_TRUE(klang::flat::flatten(*expected) ==
+              klang::flat::flatten(*actual));
+  auto const& tu = dynamic_cast<klang::ast::TranslationUnitData const&>(*actual);
+  EXPECT_EQ(200u, tu.functions().size());
+}
+
+namespace {
+
+// flat::Tree の比較は位置を見ないので、名前のソース上の位置を順に集めて
+// 比べる。
+class Offsets : public klang::ast::Visitor<Offsets> {
+ public:
+  void visit_function_definition(
+      klang::ast::FunctionDefinitionData const& node) {
+    base = node.offset();
+    Visitor<Offsets>::visit_function_definition(node);
+  }
+  void visit_identifier(klang::ast::IdentifierData const& node) {
+    offsets.push_back(base + node.offset());
+  }
+  void visit_type(klang::ast::TypeData const& node) {
+    offsets.push_back(base + node.offset());
+  }
+  std::uint32_t base = 0;
+  std::vector<std::uint32_t> offsets;
+};
+
+std::vector<std::uint32_t> offsets(klang::ast::TranslationUnit const& unit) {
+  Offsets collector;
+  collector.visit(unit);
+  return collector.offsets;
+}
+
+// code の edit の範囲を inserted で置き換えたものを、逐次版と読み直し版で
+// 読み比べる。
+void expect_same_after_edit(
+    const std::string& code, klang::Edit edit, const std::string& inserted) {
+  klang::TokenVector old_tokens;
+  std::tie(std::ignore, old_tokens) = klang::tokenize(klang::StringRef(code));
+  klang::Parser old_parser(old_tokens);
+  auto old = old_parser.parse_translation_unit();
+  std::string edited = code;
+  edited.replace(edit.offset, edit.removed, inserted);
+  edit.inserted = inserted.size();
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::retokenize(
+      old_tokens, klang::SourceBuffer::borrow(klang::StringRef(edited)), edit);
+  klang::Parser sequential(tokens);
+  const auto expected = sequential.parse_translation_unit();
+  klang::Parser incremental(tokens);
+  auto actual = incremental.reparse_translation_unit(std::move(old),
+                                                     old_tokens, edit);
+  EXPECT_TRUE(klang::flat::flatten(*expected) ==
+              klang::flat::flatten(*actual));
+  EXPECT_TRUE(offsets(*expected) == offsets(*actual));
+  auto const& e = dynamic_cast<klang::ast::TranslationUnitData const&>(*expected);
+  auto const& a = dynamic_cast<klang::ast::TranslationUnitData const&>(*actual);
+  EXPECT_EQ(e.ranges().size(), a.ranges().size());
+  for (std::size_t i = 0; i < e.ranges().size() && i < a.ranges().size(); ++i) {
+    EXPECT_EQ(e.ranges()[i].begin, a.ranges()[i].begin);
+    EXPECT_EQ(e.ranges()[i].end, a.ranges()[i].end);
+  }
+}
+
+}  // unnamed namespace
+
+TEST(parser, reparse) {
+  const std::string code = functions(50);
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+  klang::Parser parser(tokens);
+  auto old = parser.parse_translation_unit();
+  std::vector<klang::ast::FunctionDefinition const*> old_functions;
+  for (auto const& function :
+       dynamic_cast<klang::ast::TranslationUnitData const&>(*old).functions()) {
+    old_functions.push_back(function.get());
+  }
+  // f25 の中だけを書き換えれば、ほかの関数定義はそのまま引き継ぐ。
+  const std::size_t offset = code.find("10", code.find("def f25("));
+  const klang::Edit edit{offset, 2, 3};
+  std::string edited = code;
+  edited.replace(offset, 2, "100");
+  klang::TokenVector new_tokens;
+  std::tie(std::ignore, new_tokens) = klang::retokenize(
+      tokens, klang::SourceBuffer::borrow(klang::StringRef(edited)), edit);
+  klang::Parser incremental(new_tokens);
+  const auto unit = incremental.reparse_translation_unit(std::move(old),
+                                                         tokens, edit);
+  auto const& reparsed =
+      dynamic_cast<klang::ast::TranslationUnitData const&>(*unit).functions();
+  ASSERT_EQ(50u, reparsed.size());
+  for (std::size_t i = 0; i < reparsed.size(); ++i) {
+    EXPECT_EQ(i != 25, reparsed[i].get() == old_functions[i]) << i;
+  }
+  // 引き継いだ関数の名前の位置は、編集で動いた分だけずれる。
+  auto const& f26 =
+      dynamic_cast<klang::ast::FunctionDefinitionData const&>(*reparsed[26]);
+  EXPECT_EQ(edited.find("f26("),
+            f26.offset() +
+            dynamic_cast<klang::ast::IdentifierData const&>(*f26.name())
+                .offset());
+
+  // 関数の区切りやコメント、文字列が変わる編集でも逐次版と同じになる。
+  const std::string small = functions(5);
+  const std::string insertions[] = {
+    "", "x", "}", "{", "{~", "~}", "\"", "def g() -> (int) {}\n", "$", ";",
+  };
+  unsigned state = 3;
+  for (int i = 0; i < 200; ++i) {
+    state = state * 1103515245u + 12345u;
+    const std::size_t at = (state >> 8) % (small.size() + 1);
+    const std::size_t removed =
+        std::min<std::size_t>((state >> 4) % 3, small.size() - at);
+    const std::string& inserted =
+        insertions[(state >> 16) % (sizeof(insertions) / sizeof(insertions[0]))];
+    expect_same_after_edit(small, klang::Edit{at, removed, 0}, inserted);
+  }
+}
+
+namespace {
+
+std::string repeat(const std::string& str, int n) {
+  std::string ret;
+  for (int i = 0; i < n; ++i) ret += str;
+  return ret;
+}
+
+void expect_same_as_recursive(const std::string& code, bool memoize) {
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+  klang::Parser recursive(tokens, memoize);
+  const auto expected = recursive.parse_translation_unit();
+  klang::Parser iterative(tokens, memoize);
+  iterative.use_explicit_stack();
+  const auto actual = iterative.parse_translation_unit();
+  EXPECT_TRUE(klang::flat::flatten(*expected) ==
+              klang::flat::flatten(*actual)) << code;
+  EXPECT_FALSE(iterative.nesting_limit_exceeded());
+}
+
+std::size_t function_count(klang::ast::TranslationUnitPtr const& unit) {
+  return dynamic_cast<klang::ast::TranslationUnitData const&>(*unit)
+      .functions().size();
+}
+
+}  // unnamed namespace
+
+TEST(parser, explicitStack) {
+  const std::string body =
+      "  def int var x := ~n * 2 + 1;\n"
+      "  x :+= f(x, not (x =/ 0), g()) - -1;\n"
+      "  if (x = y and x < 1 or z) { x := (x); }\n"
+      "  else if (x > 1) { x := x / 2 % 3; } else { x := x <= y; }\n"
+      "  while (1) { break; }\n"
+      "  for (x := 0; x < 10; x :+= 1) { continue; }\n"
+      "  for (;;) { { } }\n"
+      "  \"s\"; 'c'; ;\n"
+      "  return a < b < c;\n";
+  const std::string code = "def f(int n) -> (int) {\n" + body + "}\n";
+  for (bool memoize : {false, true}) {
+    expect_same_as_recursive(code, memoize);
+    expect_same_as_recursive(functions(20), memoize);
+    expect_same_as_recursive(code + "def g() -> (int) { x := (x; }\n" + code,
+                             memoize);
+    // 読み損ねる位置をずらしながら、途中で切れた入力も同じに読む。
+    for (std::size_t size = 0; size < code.size(); size += 7) {
+      expect_same_as_recursive(code.substr(0, size) + "}\n" + code, memoize);
+    }
+  }
+  const std::string many = functions(100);
+  klang::Parser streaming(klang::TokenStream(
+      klang::SourceBuffer::borrow(klang::StringRef(many)), 64));
+  streaming.use_explicit_stack();
+  EXPECT_EQ(100u, function_count(streaming.parse_translation_unit()));
+}
+
+TEST(parser, explicitStackDeep) {
+  // 再帰版ではネイティブのスタックが溢れる深さ。
+  const int depth = 100000;
+  const std::vector<std::string> codes = {
+    "def main() -> (int) { x := " + repeat("(", depth) + "x" +
+        repeat(")", depth) + "; }",
+    "def main() -> (int) { x := " + repeat("f(", depth) + "x" +
+        repeat(")", depth) + "; }",
+    "def main() -> (int) " + repeat("{", depth) + repeat("}", depth),
+    "def main() -> (int) { if (x) { }" + repeat(" else if (x) { }", depth) +
+        " }",
+  };
+  for (auto const& code : codes) {
+    klang::TokenVector tokens;
+    std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+    klang::Parser parser(tokens);
+    parser.use_explicit_stack(depth + 1);
+    EXPECT_EQ(1u, function_count(parser.parse_translation_unit()));
+    EXPECT_FALSE(parser.nesting_limit_exceeded());
+  }
+}
+
+TEST(parser, nestingLimit) {
+  const std::string code =
+      "def f() -> (int) { x := ((x)); }\n"
+      "def g() -> (int) { x := " + repeat("(", 10) + "x" + repeat(")", 10) +
+      "; }\n"
+      "def h() -> (int) { }\n";
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+  // 関数本体の波括弧も 1 段に数える。
+  klang::Parser enough(tokens);
+  enough.use_explicit_stack(11);
+  EXPECT_EQ(3u, function_count(enough.parse_translation_unit()));
+  EXPECT_FALSE(enough.nesting_limit_exceeded());
+  // 深すぎる関数に来たら、後ろの関数は読まずに止まる。
+  klang::Parser limited(tokens);
+  limited.use_explicit_stack(10);
+  EXPECT_EQ(1u, function_count(limited.parse_translation_unit()));
+  EXPECT_TRUE(limited.nesting_limit_exceeded());
+}
+
+namespace {
+
+struct Recovered {
+  klang::ast::TranslationUnitPtr unit;
+  std::vector<klang::Diagnostic> diagnostics;
+};
+
+Recovered parse_with_recovery(klang::TokenVector const& tokens,
+                              bool explicit_stack, unsigned jobs = 1,
+                              bool memoize = false) {
+  klang::Parser parser(tokens, memoize);
+  parser.recover_from_errors();
+  if (explicit_stack) parser.use_explicit_stack();
+  Recovered ret;
+  ret.unit = jobs == 1 ? parser.parse_translation_unit()
+                       : parser.parse_translation_unit_in_parallel(jobs);
+  ret.diagnostics = parser.diagnostics();
+  return ret;
+}
+
+// 誤りの位置を行番号で返す。
+std::vector<unsigned> error_lines(klang::TokenVector const& tokens,
+                                  std::vector<klang::Diagnostic> const& ds) {
+  std::vector<unsigned> lines;
+  for (auto const& d : ds) {
+    lines.push_back(d.position < tokens.size()
+                    ? tokens.location(tokens[d.position]).line : 0);
+  }
+  return lines;
+}
+
+void expect_same_recovery(Recovered const& expected, Recovered const& actual) {
+  EXPECT_TRUE(klang::flat::flatten(*expected.unit) ==
+              klang::flat::flatten(*actual.unit));
+  ASSERT_EQ(expected.diagnostics.size(), actual.diagnostics.size());
+  for (std::size_t i = 0; i < expected.diagnostics.size(); ++i) {
+    EXPECT_EQ(expected.diagnostics[i].position,
+              actual.diagnostics[i].position);
+    EXPECT_EQ(expected.diagnostics[i].expected,
+              actual.diagnostics[i].expected);
+    EXPECT_EQ(expected.diagnostics[i].begin, actual.diagnostics[i].begin);
+    EXPECT_EQ(expected.diagnostics[i].end, actual.diagnostics[i].end);
+  }
+}
+
+}  // unnamed namespace
+
+TEST(parser, recovery) {
+  const std::string code =
+      "def f(int a) -> (int) {\n"
+      "  x := 1 +;\n"
+      "  if (x) { y := ); z := 2; }\n"
+      "  return x;\n"
+      "}\n"
+      "def g( -> (int) { x := 1; }\n"
+      "def h() -> (int) {\n"
+      "  return h(;\n"
+      "}\n"
+      "def k() -> (int) { return 0; }\n";
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+  const auto recursive = parse_with_recovery(tokens, false);
+  EXPECT_EQ(3u, function_count(recursive.unit));
+  EXPECT_EQ((std::vector<unsigned>{2, 3, 6, 8}),
+            error_lines(tokens, recursive.diagnostics));
+  // 読めない文は ';' まで、読めない関数定義は次の def まで読み飛ばす。
+  auto const& statement = recursive.diagnostics[0];
+  EXPECT_EQ(";", tokens.str(tokens[statement.position]));
+  EXPECT_TRUE(statement.expected & klang::ParseError::IDENTIFIER);
+  EXPECT_EQ("x", tokens.str(tokens[statement.begin]));
+  EXPECT_EQ(statement.position + 1, statement.end);
+  auto const& function = recursive.diagnostics[2];
+  EXPECT_EQ("g", tokens.str(tokens[function.begin + 1]));
+  EXPECT_EQ("h", tokens.str(tokens[function.end + 1]));
+
+  expect_same_recovery(recursive, parse_with_recovery(tokens, true));
+  expect_same_recovery(recursive, parse_with_recovery(tokens, false, 4));
+  // メモ化しても誤りの位置と集合は変わらない。読み飛ばす前に覚えた失敗を
+  // 使うと、for の 2 つ目の誤りの位置が手前にずれたり ("(")、読めたはずの
+  // ものが欠けたり ("f") していた。
+  for (bool explicit_stack : {false, true}) {
+    expect_same_recovery(recursive,
+                         parse_with_recovery(tokens, explicit_stack, 1, true));
+  }
+  for (const char* for_code : {"def f() -> (int) { for (; (",
+                               "def f() -> (int) { for (; f"}) {
+    klang::TokenVector for_tokens;
+    std::tie(std::ignore, for_tokens) =
+        klang::tokenize(klang::StringRef(for_code));
+    const auto for_recursive = parse_with_recovery(for_tokens, false);
+    EXPECT_EQ(2u, for_recursive.diagnostics.size());
+    for (bool explicit_stack : {false, true}) {
+      expect_same_recovery(
+          for_recursive,
+          parse_with_recovery(for_tokens, explicit_stack, 1, true));
+    }
+  }
+
+  // 回復しなければ、これまでどおり最初の誤りで止まる。
+  klang::Parser strict(tokens);
+  EXPECT_EQ(0u, function_count(strict.parse_translation_unit()));
+  EXPECT_TRUE(strict.diagnostics().empty());
+}
+
+TEST(parser, recoveryMissingBrace) {
+  // 閉じ波括弧が足りなければ、次の関数定義の def で立て直す。
+  const std::string code =
+      "def f() -> (int) {\n"
+      "  if (x) {\n"
+      "    x := 1;\n"
+      "def g() -> (int) { return 0; }\n"
+      "x := 1;\n";
+  klang::TokenVector tokens;
+  std::tie(std::ignore, tokens) = klang::tokenize(klang::StringRef(code));
+  const auto recursive = parse_with_recovery(tokens, false);
+  EXPECT_EQ(1u, function_count(recursive.unit));
+  EXPECT_EQ((std::vector<unsigned>{4, 5}),
+            error_lines(tokens, recursive.diagnostics));
+  EXPECT_EQ(tokens.size(), recursive.diagnostics.back().end);
+  expect_same_recovery(recursive, parse_with_recovery(tokens, true));
+}
@@ -0,0 +1,74 @@
+#include "gtest.h"
+
+#include "scan.hpp"
+
+#include <string>
+
+namespace {
+
+using klang::scan::Isa;
+
+// SIMD の実装が、ブロックの端や端数を含むどの区間でも 1 バイトずつ
+// 調べたのと同じ位置を返すか確かめる。
+void expect_same_as_scalar(Isa isa, const std::string& text) {
+  if (!klang::scan::supported(isa)) return;
+  auto const& expect = klang::scan::scanner(Isa::SCALAR);
+  auto const& actual = klang::scan::scanner(isa);
+  const char* const data = text.data();
+  for (std::size_t first = 0; first <= text.size(); ++first) {
+    for (std::size_t last = first; last <= text.size(); ++last) {
+      const char* const f = data + first;
+      const char* const l = data + last;
+      ASSERT_EQ(expect.find(f, l, '\n'), actual.find(f, l, '\n'))
+          << first << ", " << last;
+      ASSERT_EQ(expect.find_either(f, l, '"', '\\'),
+                actual.find_either(f, l, '"', '\\'))
+          << first << ", " << last;
+      ASSERT_EQ(expect.skip_spaces(f, l), actual.skip_spaces(f, l))
+          << first << ", " << last;
+    }
+  }
+}
+
+std::string sample(std::size_t size, unsigned seed) {
+  const char alphabet[] = " \t\n\v\f\r\"\\\x08\x0e\x1f!a{~}\x80\xff";
+  std::string text;
+  unsigned state = seed;
+  for (std::size_t i = 0; i < size; ++i) {
+    state = state * 1103515245u + 12345u;
+    // 空白を多めにして、長い空白の並びも作る。
+    const unsigned r = (state >> 16) % 64;
+    text += r < 40 ? ' ' : alphabet[r % (sizeof(alphabet) - 1)];
+  }
+  return text;
+}
+
+}  // unnamed namespace
+
+TEST(scan, scalar) {
+  auto const& s = klang::scan::scanner(Isa::SCALAR);
+  const std::string text = " \t\v\f\r\nx\"y\\";
+  const char* const first = text.data();
+  const char* const last = first + text.size();
+  EXPECT_EQ(first + 5, s.find(first, last, '\n'));
+  EXPECT_EQ(last, s.find(first, last, '$'));
+  EXPECT_EQ(first + 7, s.find_either(first, last, '\\', '"'));
+  EXPECT_EQ(first + 6, s.skip_spaces(first, last));
+  EXPECT_EQ(last, s.skip_spaces(last, last));
+}
+
+TEST(scan, sameAsScalar) {
+  for (Isa isa : {Isa::SSE2, Isa::AVX2}) {
+    expect_same_as_scalar(isa, sample(150, 1));
+    expect_same_as_scalar(isa, std::string(100, ' '));
+    expect_same_as_scalar(isa, std::string(100, 'x'));
+  }
+}
+
+TEST(scan, best) {
+  EXPECT_TRUE(klang::scan::supported(Isa::SCALAR));
+  auto const& best = klang::scan::scanner();
+  const std::string text = std::string(1000, ' ') + "x";
+  EXPECT_EQ(text.data() + 1000,
+            best.skip_spaces(text.data(), text.data() + text.size()));
+}